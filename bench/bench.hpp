@@ -0,0 +1,133 @@
+#ifndef HIDO_BENCH_BENCH_HPP
+#define HIDO_BENCH_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// timed samples a measurement is split into, fewer if there are fewer calls
+constexpr size_t MAX_SAMPLES = 25;
+// samples taken however expensive a call is, so percentiles mean something.
+// Too few for a p99, the slowest sample is reported as the max instead.
+constexpr size_t MIN_SAMPLES = 5;
+
+/**
+ * Time per call over repeated samples, in whatever unit it was scaled to
+ */
+struct Timing {
+    double mean = 0, min = 0, p50 = 0, p90 = 0, max = 0;
+    size_t samples = 0;
+    // calls of fn made while measuring, warm-up included
+    size_t runs = 0;
+
+    Timing scaled(double factor) const {
+        Timing t = *this;
+        t.mean *= factor;
+        t.min *= factor;
+        t.p50 *= factor;
+        t.p90 *= factor;
+        t.max *= factor;
+        return t;
+    }
+};
+
+/**
+ * Times fn in samples of consecutive calls after an untimed warm-up sample
+ * @param calls timed calls, split evenly between the samples
+ * @returns microseconds per call across the samples
+ */
+template <typename F>
+Timing measure(F &&fn, size_t calls) {
+    size_t samples = std::clamp(calls, MIN_SAMPLES, MAX_SAMPLES);
+    size_t per_sample = std::max<size_t>(1, calls / samples);
+
+    // fill caches and grow anything lazily allocated
+    for (size_t i = 0; i < per_sample; ++i) {
+        fn();
+    }
+
+    std::vector<double> us(samples);
+    for (double &sample : us) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < per_sample; ++i) {
+            fn();
+        }
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+        sample = elapsed.count() / per_sample;
+    }
+
+    std::sort(us.begin(), us.end());
+    Timing t;
+    for (double sample : us) {
+        t.mean += sample / samples;
+    }
+    // nearest rank
+    auto percentile = [&](double p) {
+        return us[std::min(samples - 1, size_t(p * samples))];
+    };
+    t.min = us.front();
+    t.p50 = percentile(0.5);
+    t.p90 = percentile(0.9);
+    t.max = us.back();
+    t.samples = samples;
+    t.runs = per_sample * (samples + 1);
+    return t;
+}
+
+/**
+ * Times fn over a number of calls
+ * @returns median microseconds per call
+ */
+template <typename F>
+double time_per_call(F &&fn, size_t calls) {
+    return measure(fn, calls).p50;
+}
+
+/**
+ * Keeps a result for the JSON report
+ * @param suite the bench_ function it came from
+ * @param name the case and its parameters, unique within the suite
+ * @param unit what the timing was scaled to, like "ns/entity"
+ */
+void record(const std::string &suite,
+            const std::string &name,
+            const std::string &unit,
+            const Timing &timing);
+
+/**
+ * Writes every recorded result as JSON, - for stdout
+ * @returns false if the file couldn't be written
+ */
+bool write_json(const std::string &path);
+
+/**
+ * @returns heap allocations made through operator new so far
+ */
+size_t allocation_count();
+
+/**
+ * Bullet vs player hit testing, linear scan against the grid broadphase
+ */
+void bench_broadphase();
+
+/**
+ * Tile collision and property queries on map1.tmx and on larger generated
+ * maps, timed and checked for allocations
+ */
+void bench_collision();
+
+/**
+ * Per tick bullet cost at 1k to 30k bullets, SoA pool against AoS
+ */
+void bench_bullets();
+
+/**
+ * Snapshot and input encoding and decoding, and picking the snapshots to
+ * interpolate between
+ */
+void bench_serialization();
+
+#endif // HIDO_BENCH_BENCH_HPP
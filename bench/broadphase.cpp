@@ -0,0 +1,90 @@
+#include <fmt/core.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "server/hitbox_history.hpp"
+#include "state/bullet.hpp"
+#include "state/player.hpp"
+
+namespace {
+
+// a 64x64 map of 16px tiles
+constexpr uint32_t MAP_TILES = 64;
+constexpr float TILE_SIZE = 16;
+
+struct Scene {
+    HitboxFrame frame;
+    std::vector<Rectangle> bullets;
+};
+
+Scene make_scene(size_t players, size_t bullets) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> pos(0, MAP_TILES * TILE_SIZE);
+
+    Scene scene;
+    scene.frame.grid.configure(TILE_SIZE, TILE_SIZE, MAP_TILES, MAP_TILES);
+    for (size_t i = 0; i < players; ++i) {
+        scene.frame.push(i, {pos(rng), pos(rng), PLAYER_WIDTH, PLAYER_HEIGHT});
+    }
+    for (size_t i = 0; i < bullets; ++i) {
+        scene.bullets.push_back({pos(rng), pos(rng), BULLET_SIZE, BULLET_SIZE});
+    }
+    return scene;
+}
+
+// what HitboxFrame::hit_test did before the grid
+int linear_hit_test(const HitboxFrame &frame,
+                    const Rectangle &rect,
+                    int ignore_id) {
+    for (size_t i = 0; i < frame.size(); ++i) {
+        bool overlap = rect.x < frame.x[i] + frame.width[i] &&
+                       rect.x + rect.width > frame.x[i] &&
+                       rect.y < frame.y[i] + frame.height[i] &&
+                       rect.y + rect.height > frame.y[i];
+        if (overlap && frame.ids[i] != ignore_id) return frame.ids[i];
+    }
+    return -1;
+}
+
+} // namespace
+
+void bench_broadphase() {
+    fmt::print("broadphase: median us per tick, bullets x players\n");
+    fmt::print("{:>8} {:>8} {:>12} {:>12} {:>8}\n", "players", "bullets",
+               "linear", "grid", "speedup");
+
+    for (size_t players : {16, 64, 256, 1024}) {
+        for (size_t bullets : {100, 1000, 10000}) {
+            Scene scene = make_scene(players, bullets);
+            // keep the compiler from dropping the tests
+            volatile int sink = 0;
+            size_t calls = std::max<size_t>(1, 2000000 / (players * bullets));
+
+            Timing linear = measure(
+                [&] {
+                    for (const Rectangle &bullet : scene.bullets) {
+                        sink = sink + linear_hit_test(scene.frame, bullet, -1);
+                    }
+                },
+                calls);
+            // the grid is rebuilt every tick so that counts too
+            Timing grid = measure(
+                [&] {
+                    scene.frame.build_grid();
+                    for (const Rectangle &bullet : scene.bullets) {
+                        sink = sink + scene.frame.hit_test(bullet, -1);
+                    }
+                },
+                calls);
+            fmt::print("{:>8} {:>8} {:>12.1f} {:>12.1f} {:>7.1f}x\n",
+                       players, bullets, linear.p50, grid.p50,
+                       linear.p50 / grid.p50);
+            std::string params = fmt::format("{}x{}", players, bullets);
+            record("broadphase", "linear/" + params, "us/tick", linear);
+            record("broadphase", "grid/" + params, "us/tick", grid);
+        }
+    }
+}
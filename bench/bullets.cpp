@@ -0,0 +1,141 @@
+#include <fmt/core.h>
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "server/bullet_pool.hpp"
+#include "server/bullet_simd.hpp"
+#include "server/hitbox_history.hpp"
+#include "state/bullet.hpp"
+#include "state/player.hpp"
+
+namespace {
+
+// a 64x64 map of 16px tiles with a crowd of players
+constexpr uint32_t MAP_TILES = 64;
+constexpr float TILE_SIZE = 16;
+constexpr size_t PLAYERS = 256;
+constexpr uint32_t TICK = 1000;
+
+} // namespace
+
+void bench_bullets() {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> pos(0, MAP_TILES * TILE_SIZE);
+    std::uniform_real_distribution<float> angle(0, 2 * PI);
+
+    HitboxFrame frame;
+    frame.grid.configure(TILE_SIZE, TILE_SIZE, MAP_TILES, MAP_TILES);
+    for (size_t i = 0; i < PLAYERS; ++i) {
+        frame.push(i, {pos(rng), pos(rng), PLAYER_WIDTH, PLAYER_HEIGHT});
+    }
+    frame.build_grid();
+
+    fmt::print("\nbullets: median ns per bullet per tick, {} kernels, "
+               "{} players\n",
+               bullet_simd_name(),
+               PLAYERS);
+    fmt::print("{:>8} {:>10} {:>10} {:>10} {:>10} {:>12}\n",
+               "bullets",
+               "aos",
+               "scalar",
+               "simd",
+               "soa tick",
+               "bullets/s");
+
+    for (size_t n : {1000, 10000, 30000}) {
+        BulletPool pool;
+        std::vector<BulletState> aos;
+        for (size_t i = 0; i < n; ++i) {
+            float a = angle(rng);
+            BulletState bullet;
+            bullet.sender = i % PLAYERS;
+            bullet.origin = {pos(rng), pos(rng)};
+            bullet.vel = {std::cos(a) * BULLET_SPEED,
+                          std::sin(a) * BULLET_SPEED};
+            bullet.spawn_tick = TICK - i % 60;
+            bullet.impact_tick = TICK + 60;
+            bullet.id = pool.spawn(bullet);
+            aos.push_back(bullet);
+        }
+        volatile int sink = 0;
+        const size_t calls = 200;
+
+        // the per bullet path, place and test one at a time
+        Timing aos_ns = measure(
+                            [&] {
+                                int hits = 0;
+                                for (const BulletState &b : aos) {
+                                    if (TICK >= b.impact_tick) continue;
+                                    Vector2 p = bullet_position(b, TICK);
+                                    hits += frame.hit_test(
+                                                {p.x, p.y, BULLET_SIZE,
+                                                 BULLET_SIZE},
+                                                b.sender) >= 0;
+                                }
+                                sink = hits;
+                            },
+                            calls)
+                            .scaled(1000.0 / n);
+
+        // just placing and expiring, both paths
+        std::vector<float> origin_x(n), origin_y(n), vel_x(n), vel_y(n);
+        std::vector<uint32_t> spawn(n), impact(n), expired(n);
+        std::vector<float> x(n), y(n);
+        for (size_t i = 0; i < n; ++i) {
+            origin_x[i] = aos[i].origin.x;
+            origin_y[i] = aos[i].origin.y;
+            vel_x[i] = aos[i].vel.x;
+            vel_y[i] = aos[i].vel.y;
+            spawn[i] = aos[i].spawn_tick;
+            impact[i] = aos[i].impact_tick;
+        }
+        BulletColumns columns{origin_x.data(),
+                              origin_y.data(),
+                              vel_x.data(),
+                              vel_y.data(),
+                              spawn.data(),
+                              impact.data(),
+                              x.data(),
+                              y.data(),
+                              expired.data(),
+                              n};
+        Timing scalar_ns =
+            measure([&] { advance_bullets_scalar(columns, TICK); }, calls)
+                .scaled(1000.0 / n);
+        Timing simd_ns =
+            measure([&] { advance_bullets(columns, TICK); }, calls)
+                .scaled(1000.0 / n);
+
+        // what a server tick does, minus removals so every call sees n
+        Timing soa_ns = measure(
+                            [&] {
+                                pool.advance(TICK);
+                                int hits = 0;
+                                for (size_t i = 0; i < pool.count(); ++i) {
+                                    if (pool.expired(i)) continue;
+                                    hits += frame.hit_test(pool.rect(i),
+                                                           pool.sender(i)) >= 0;
+                                }
+                                sink = hits;
+                            },
+                            calls)
+                            .scaled(1000.0 / n);
+
+        fmt::print("{:>8} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f} {:>12.3g}\n",
+                   n,
+                   aos_ns.p50,
+                   scalar_ns.p50,
+                   simd_ns.p50,
+                   soa_ns.p50,
+                   1e9 / soa_ns.p50);
+        std::string bullets = std::to_string(n);
+        record("bullets", "aos/" + bullets, "ns/bullet", aos_ns);
+        record("bullets", "scalar/" + bullets, "ns/bullet", scalar_ns);
+        record("bullets", "simd/" + bullets, "ns/bullet", simd_ns);
+        record("bullets", "soa_tick/" + bullets, "ns/bullet", soa_ns);
+    }
+}
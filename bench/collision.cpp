@@ -0,0 +1,160 @@
+#include <fmt/core.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "map/map.hpp"
+#include "state/bullet.hpp"
+#include "state/player.hpp"
+
+namespace {
+
+constexpr size_t ENTITIES = 1024;
+constexpr size_t CALLS = 200;
+
+// prints time and allocations per entity for one pass over every entity
+template <typename F>
+void report(const std::string &map_name, const char *name, F &&pass) {
+    // first pass grows anything lazily allocated
+    pass();
+    size_t before = allocation_count();
+    Timing t = measure(pass, CALLS).scaled(1000.0 / ENTITIES);
+    double allocs =
+        (double)(allocation_count() - before) / (t.runs * ENTITIES);
+    fmt::print("{:>28} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.2f}\n", name,
+               t.p50, t.p90, t.max, allocs);
+    record("collision", std::string(name) + "/" + map_name, "ns/entity", t);
+}
+
+/**
+ * Writes map1 repeated copies times in each direction next to the other
+ * temporary files, using the same tileset
+ * @returns path of the written map, empty if it couldn't be written
+ */
+std::string write_tiled_map(const GameMap &map1, uint32_t copies) {
+    uint32_t width = map1.width * copies, height = map1.height * copies;
+    std::string name = fmt::format("hido-bench-{}x{}.tmx", width, height);
+    std::string path =
+        (std::filesystem::temp_directory_path() / name).string();
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file) return "";
+
+    fmt::print(file,
+               "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<map version=\"1.8\" orientation=\"orthogonal\" "
+               "renderorder=\"right-down\" width=\"{0}\" height=\"{1}\" "
+               "tilewidth=\"{2}\" tileheight=\"{3}\" infinite=\"0\">\n"
+               " <tileset firstgid=\"1\" source=\"tileset.tsx\"/>\n"
+               " <layer id=\"1\" name=\"Tile Layer 1\" width=\"{0}\" "
+               "height=\"{1}\">\n"
+               "  <data encoding=\"csv\">\n",
+               width, height, map1.tileWidth, map1.tileHeight);
+    const std::vector<tmxparser::Tile> &tiles = map1.layerCollection[0].tiles;
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t idx = (y % map1.height) * map1.width + x % map1.width;
+            bool last = x == width - 1 && y == height - 1;
+            fmt::print(file, "{}{}", tiles[idx].gid, last ? "" : ",");
+        }
+        fmt::print(file, "\n");
+    }
+    fmt::print(file, "</data>\n </layer>\n</map>\n");
+    return std::fclose(file) == 0 ? path : "";
+}
+
+void bench_map(GameMap &map, const std::string &map_name) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> pos_x(0, map.width * map.tileWidth);
+    std::uniform_real_distribution<float> pos_y(0,
+                                                map.height * map.tileHeight);
+    std::uniform_real_distribution<float> dir(-1, 1);
+
+    std::vector<PlayerState> players(ENTITIES);
+    std::vector<Vector2> velocities(ENTITIES);
+    std::vector<BulletState> bullets(ENTITIES);
+    for (size_t i = 0; i < ENTITIES; ++i) {
+        do {
+            players[i].rect.x = pos_x(rng);
+            players[i].rect.y = pos_y(rng);
+        } while (map.rect_blocked(players[i].rect));
+        velocities[i] = {dir(rng) * PLAYER_SPEED, dir(rng) * PLAYER_SPEED};
+        bullets[i].origin = {pos_x(rng), pos_y(rng)};
+        bullets[i].vel = {dir(rng) * BULLET_SPEED, dir(rng) * BULLET_SPEED};
+    }
+
+    fmt::print("\ncollision: per entity on {} ({}x{} tiles)\n", map_name,
+               map.width, map.height);
+    fmt::print("{:>28} {:>10} {:>10} {:>10} {:>10}\n", "", "p50 ns", "p90 ns",
+               "max ns", "allocs");
+    report(map_name, "player_update", [&] {
+        for (size_t i = 0; i < ENTITIES; ++i) {
+            player_update(players[i], velocities[i], 1.0f / 60.0f, map);
+        }
+    });
+    report(map_name, "bullet_impact_time", [&] {
+        float sum = 0.0f;
+        for (const BulletState &bullet : bullets) {
+            sum += bullet_impact_time(bullet.origin, bullet.vel, map);
+        }
+        volatile float sink = sum;
+        (void)sink;
+    });
+    report(map_name, "for_each_intersecting_tile", [&] {
+        size_t n = 0;
+        for (const PlayerState &p : players) {
+            map.for_each_intersecting_tile(
+                p.rect, [&](tmxparser::Tile &, unsigned int) {
+                    ++n;
+                    return false;
+                });
+        }
+        volatile size_t sink = n;
+        (void)sink;
+    });
+    report(map_name, "get_intersect_rects", [&] {
+        for (const PlayerState &p : players) {
+            std::vector<tmxparser::Tile *> tiles;
+            std::vector<unsigned int> indices;
+            map.get_intersect_rects(p.rect, tiles, indices);
+        }
+    });
+    // what baking the blocked bitmap does for every tile
+    report(map_name, "contains_property", [&] {
+        size_t n = 0;
+        std::string out;
+        for (const PlayerState &p : players) {
+            map.for_each_intersecting_tile(
+                p.rect, [&](tmxparser::Tile &tile, unsigned int) {
+                    n += map.contains_property(tile, "blocked", out);
+                    return false;
+                });
+        }
+        volatile size_t sink = n;
+        (void)sink;
+    });
+}
+
+} // namespace
+
+void bench_collision() {
+    GameMap map1("./res/map/map1.tmx", "./res/map");
+    if (map1.width == 0) return;
+    bench_map(map1, "map1");
+
+    // the same rooms over and over, so only the size changes
+    for (uint32_t copies : {5, 25}) {
+        std::string path = write_tiled_map(map1, copies);
+        if (path.empty()) {
+            fmt::print(stderr, "couldn't write a {}x map\n", copies);
+            continue;
+        }
+        GameMap map(path, "./res/map");
+        std::filesystem::remove(path);
+        if (map.width == 0) continue;
+        bench_map(map, fmt::format("map1x{}", copies));
+    }
+}
@@ -0,0 +1,53 @@
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+namespace {
+
+struct Suite {
+    const char *name;
+    void (*run)();
+};
+
+constexpr Suite SUITES[] = {
+    {"broadphase", bench_broadphase},
+    {"collision", bench_collision},
+    {"bullets", bench_bullets},
+    {"serialization", bench_serialization},
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string json;
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        } else if (argv[i][0] != '-') {
+            selected.push_back(argv[i]);
+        } else {
+            fmt::print(stderr, "usage: {} [--json file] [suite...]\n",
+                       argv[0]);
+            return 1;
+        }
+    }
+
+    for (const Suite &suite : SUITES) {
+        if (selected.empty() || std::find(selected.begin(), selected.end(),
+                                          suite.name) != selected.end()) {
+            suite.run();
+        }
+    }
+
+    if (!json.empty() && !write_json(json)) {
+        fmt::print(stderr, "couldn't write {}\n", json);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <fmt/core.h>
+
+#include <cstdio>
+
+#include "bench.hpp"
+
+namespace {
+
+struct Result {
+    std::string suite, name, unit;
+    Timing timing;
+};
+
+std::vector<Result> results;
+
+// names are plain ascii, quotes and backslashes are all there is to escape
+std::string quote(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+void record(const std::string &suite,
+            const std::string &name,
+            const std::string &unit,
+            const Timing &timing) {
+    results.push_back({suite, name, unit, timing});
+}
+
+bool write_json(const std::string &path) {
+    FILE *file = path == "-" ? stdout : std::fopen(path.c_str(), "w");
+    if (!file) return false;
+
+    fmt::print(file, "{{\n  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        const Timing &t = r.timing;
+        fmt::print(file,
+                   "{}\n    {{\"suite\": {}, \"name\": {}, \"unit\": {}, "
+                   "\"mean\": {:.6g}, \"min\": {:.6g}, \"p50\": {:.6g}, "
+                   "\"p90\": {:.6g}, \"max\": {:.6g}, \"samples\": {}}}",
+                   i ? "," : "",
+                   quote(r.suite),
+                   quote(r.name),
+                   quote(r.unit),
+                   t.mean,
+                   t.min,
+                   t.p50,
+                   t.p90,
+                   t.max,
+                   t.samples);
+    }
+    fmt::print(file, "\n  ]\n}}\n");
+
+    bool ok = !std::ferror(file);
+    if (file != stdout) ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
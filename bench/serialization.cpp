@@ -0,0 +1,212 @@
+#include <fmt/core.h>
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "network.hpp"
+#include "snapshot.hpp"
+#include "state/bullet.hpp"
+#include "state/player.hpp"
+#include "state_buffer.hpp"
+
+namespace {
+
+// consecutive ticks encoded as a chain of deltas
+constexpr size_t TICKS = 32;
+constexpr uint32_t FIRST_TICK = 1000;
+constexpr uint64_t TICK_MILLIS = 16;
+constexpr size_t CALLS = 200;
+
+/**
+ * A server's snapshots over TICKS ticks, every player moving and a few
+ * bullets replaced each tick
+ */
+std::vector<GameStatePacket> make_ticks(size_t players, size_t bullets) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> pos(0, 1024);
+    std::uniform_real_distribution<float> angle(0, 2 * PI);
+    std::uniform_real_distribution<float> step(-2, 2);
+    // a tenth of the bullets expire and respawn every tick
+    const size_t spawned = std::max<size_t>(1, bullets / 10);
+
+    std::vector<GameStatePacket> ticks(TICKS);
+    GameStatePacket state;
+    state.header.type = PacketType::GAME_STATE;
+    for (size_t i = 0; i < players; ++i) {
+        PlayerState p;
+        p.id = i;
+        p.rect.x = pos(rng);
+        p.rect.y = pos(rng);
+        state.players.push_back(p);
+    }
+    for (size_t t = 0; t < TICKS; ++t) {
+        state.sequence = FIRST_TICK + t;
+        state.timestamp = state.sequence * TICK_MILLIS;
+        for (PlayerState &p : state.players) {
+            p.rect.x += step(rng);
+            p.rect.y += step(rng);
+            if (rng() % 16 == 0) p.health = std::max(0.0f, p.health - 0.1f);
+        }
+        // ids only grow, so dropping the front keeps them sorted
+        size_t first = t == 0 ? 0 : std::min(spawned, state.bullets.size());
+        state.bullets.erase(state.bullets.begin(),
+                            state.bullets.begin() + first);
+        while (state.bullets.size() < bullets) {
+            float a = angle(rng);
+            BulletState b;
+            b.id = t * bullets + state.bullets.size();
+            b.sender = rng() % players;
+            b.origin = {pos(rng), pos(rng)};
+            b.vel = {std::cos(a) * BULLET_SPEED, std::sin(a) * BULLET_SPEED};
+            b.spawn_tick = state.sequence;
+            b.impact_tick = state.sequence + 60;
+            state.bullets.push_back(b);
+        }
+        ticks[t] = state;
+    }
+    return ticks;
+}
+
+void bench_snapshots(size_t players, size_t bullets) {
+    std::vector<GameStatePacket> ticks = make_ticks(players, bullets);
+    std::string params = fmt::format("{}p/{}b", players, bullets);
+    Packet packet;
+
+    // every tick against the one before it, as a client that acks each
+    // snapshot sees them
+    std::vector<Packet> fragments;
+    std::vector<size_t> lengths;
+    size_t full_bytes = 0, delta_bytes = 0;
+    for (size_t t = 0; t < TICKS; ++t) {
+        const GameStatePacket *baseline = t == 0 ? nullptr : &ticks[t - 1];
+        encode_game_state(ticks[t],
+                          baseline,
+                          packet,
+                          [&](const Packet &fragment, size_t len) {
+                              fragments.push_back(fragment);
+                              lengths.push_back(len);
+                              (t == 0 ? full_bytes : delta_bytes) += len;
+                          });
+    }
+
+    size_t sink = 0;
+    auto count = [&](const Packet &, size_t len) { sink += len; };
+    Timing full = measure(
+        [&] { encode_game_state(ticks.back(), nullptr, packet, count); },
+        CALLS);
+    Timing delta = measure(
+        [&] {
+            for (size_t t = 1; t < TICKS; ++t) {
+                encode_game_state(ticks[t], &ticks[t - 1], packet, count);
+            }
+        },
+        CALLS);
+    delta = delta.scaled(1.0 / (TICKS - 1));
+    // a fresh decoder per pass, so the chain starts from a full snapshot
+    Timing decode = measure(
+        [&] {
+            SnapshotDecoder decoder;
+            GameStatePacket out;
+            for (size_t i = 0; i < fragments.size(); ++i) {
+                sink += decoder.decode(fragments[i], lengths[i],
+                                       FIRST_TICK, out);
+            }
+        },
+        CALLS);
+    decode = decode.scaled(1.0 / TICKS);
+    volatile size_t keep = sink;
+    (void)keep;
+
+    fmt::print("{:>8} {:>8} {:>10.1f} {:>10.1f} {:>10.1f} {:>10} {:>10}\n",
+               players, bullets, full.p50, delta.p50, decode.p50, full_bytes,
+               delta_bytes / (TICKS - 1));
+    record("serialization", "encode_full/" + params, "us/snapshot", full);
+    record("serialization", "encode_delta/" + params, "us/snapshot", delta);
+    record("serialization", "decode/" + params, "us/snapshot", decode);
+}
+
+void bench_inputs() {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> pos(0, 1024);
+    InputBatch batch;
+    batch.header.type = PacketType::INPUT;
+    batch.header.sender = 1;
+    batch.ack_snapshot = FIRST_TICK;
+    batch.count = MAX_INPUT_BATCH;
+    for (size_t i = 0; i < MAX_INPUT_BATCH; ++i) {
+        InputPacket &input = batch.inputs[i];
+        input.sequence = 100 + i;
+        input.left = rng() % 2;
+        input.up = rng() % 2;
+        input.mouse_down = i % 4 == 0;
+        input.mouse_pos = {pos(rng), pos(rng)};
+        input.dt = 1.0f / 60.0f;
+        input.view_tick = input.mouse_down ? FIRST_TICK - 6 : 0;
+    }
+
+    Packet packet;
+    size_t len = serialize(batch, packet);
+    InputBatch out;
+    Timing write = measure([&] { len = serialize(batch, packet); }, CALLS);
+    Timing read = measure(
+        [&] { deserialize(packet, len, out, 99, FIRST_TICK); }, CALLS);
+
+    fmt::print("\nserialization: median us per input batch of {}, {} bytes\n",
+               MAX_INPUT_BATCH, len);
+    fmt::print("{:>10} {:>10}\n", "write", "read");
+    fmt::print("{:>10.3f} {:>10.3f}\n", write.p50, read.p50);
+    std::string params = std::to_string(MAX_INPUT_BATCH);
+    record("serialization", "input_write/" + params, "us/batch", write);
+    record("serialization", "input_read/" + params, "us/batch", read);
+}
+
+void bench_state_buffer() {
+    constexpr size_t SAMPLES = 1024;
+    StateBuffer<GameStatePacket, 32> buffer;
+    for (size_t t = 0; t < 32; ++t) {
+        buffer.push().timestamp = (FIRST_TICK + t) * TICK_MILLIS;
+    }
+    // render times spread over the buffer and a little past both ends
+    std::vector<uint64_t> times(SAMPLES);
+    uint64_t from = (FIRST_TICK - 2) * TICK_MILLIS;
+    uint64_t span = 36 * TICK_MILLIS;
+    for (size_t i = 0; i < SAMPLES; ++i) {
+        times[i] = from + i * span / SAMPLES;
+    }
+
+    float sum = 0.0f;
+    Timing sample = measure(
+                        [&] {
+                            StateSample<GameStatePacket> out;
+                            for (uint64_t time : times) {
+                                if (buffer.sample(time, out)) sum += out.t;
+                            }
+                        },
+                        CALLS)
+                        .scaled(1000.0 / SAMPLES);
+    volatile float sink = sum;
+    (void)sink;
+
+    fmt::print("\nserialization: StateBuffer::sample over 32 snapshots\n");
+    fmt::print("{:>10} {:>10} {:>10}\n", "p50 ns", "p90 ns", "max ns");
+    fmt::print("{:>10.1f} {:>10.1f} {:>10.1f}\n", sample.p50, sample.p90,
+               sample.max);
+    record("serialization", "state_buffer_sample/32", "ns/sample", sample);
+}
+
+} // namespace
+
+void bench_serialization() {
+    fmt::print("\nserialization: median us per snapshot, {} tick chains\n",
+               TICKS);
+    fmt::print("{:>8} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10}\n", "players",
+               "bullets", "full", "delta", "decode", "full B", "delta B");
+    for (size_t players : {16, 128, 512}) {
+        bench_snapshots(players, players * 4);
+    }
+    bench_inputs();
+    bench_state_buffer();
+}
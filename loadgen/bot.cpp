@@ -0,0 +1,158 @@
+#include "bot.hpp"
+
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// how often connects and disconnects are resent
+constexpr uint64_t RESEND_INTERVAL = 50;
+}
+
+Bot::Bot(const sockaddr_in &server, uint32_t seed)
+    : server(server), rng(seed) {
+    // a socket each, the server tells clients apart by address
+    sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (sock < 0) {
+        spdlog::error("Error creating bot socket: {}", strerror(errno));
+    }
+}
+
+Bot::~Bot() {
+    if (sock >= 0) close(sock);
+}
+
+void Bot::send(const void *data, size_t len, SendBatch &batch) {
+    batch.push(sock, data, len, server);
+    stats.bytes_sent += len;
+    stats.packets_sent++;
+}
+
+void Bot::frame(uint64_t now, bool disconnecting, SendBatch &batch) {
+    Packet packet;
+    if (disconnecting) {
+        // never got in, nothing to leave
+        if (!connected()) gone = true;
+        if (gone || now < next_resend) return;
+        next_resend = now + RESEND_INTERVAL;
+        ClientPacket p{};
+        p.header.type = PacketType::CLIENT_DISCONNECT;
+        send(packet.data(), serialize(p, packet), batch);
+        return;
+    }
+    if (!connected()) {
+        if (now < next_resend) return;
+        next_resend = now + RESEND_INTERVAL;
+        ClientPacket p{};
+        p.header.type = PacketType::CLIENT_CONNECT;
+        strcpy(p.name, "bot");
+        send(packet.data(), serialize(p, packet), batch);
+        return;
+    }
+    if (clock.ping_due(now)) {
+        PingPacket p{.header = {.type = PacketType::PING, .sender = client_id}};
+        p.client_time = now;
+        send(packet.data(), serialize(p, packet), batch);
+    }
+
+    // wander, changing direction every second or so
+    if (now >= next_turn) {
+        std::uniform_int_distribution<int> key(0, 1);
+        left_key = key(rng);
+        right_key = key(rng);
+        up_key = key(rng);
+        down_key = key(rng);
+        next_turn = now + std::uniform_int_distribution<int>(500, 1500)(rng);
+    }
+    InputPacket input;
+    input.sequence = ++input_sequence;
+    input.left = left_key;
+    input.right = right_key;
+    input.up = up_key;
+    input.down = down_key;
+    input.dt = DT_QUANTIZATION.round(TICK_DT);
+    // and shoot somewhere nearby a couple of times a second
+    if (now >= next_shot) {
+        float angle = std::uniform_real_distribution<float>(0.0f, 2 * PI)(rng);
+        input.mouse_down = true;
+        input.mouse_pos = {position.x + 50.0f * std::cos(angle),
+                           position.y + 50.0f * std::sin(angle)};
+        next_shot = now + std::uniform_int_distribution<int>(300, 1000)(rng);
+    }
+    // others are rendered about the interpolation delay behind
+    uint32_t delay_ticks = clock.get_delay() / TICK_INTERVAL;
+    if (ack_snapshot > delay_ticks) {
+        input.view_tick = ack_snapshot - delay_ticks;
+    }
+    unacknowledged.push_back(input);
+    // only the tail is ever resent
+    if (unacknowledged.size() > MAX_INPUT_BATCH) {
+        unacknowledged.erase(unacknowledged.begin());
+    }
+
+    InputBatch p;
+    p.header.type = PacketType::INPUT;
+    p.header.sender = client_id;
+    p.ack_snapshot = ack_snapshot;
+    p.count = std::min(clock.input_redundancy(), unacknowledged.size());
+    std::copy(unacknowledged.end() - p.count,
+              unacknowledged.end(),
+              p.inputs.begin());
+    send(packet.data(), serialize(p, packet), batch);
+}
+
+void Bot::receive(const Packet &packet, size_t len, uint64_t now) {
+    PacketHeader header;
+    if (!peek_header(packet, len, header)) return;
+    stats.bytes_received += len;
+    stats.packets_received++;
+
+    if (header.type == PacketType::GAME_STATE) {
+        if (!decoder.decode(packet, len, server_tick, state)) return;
+        if (state.sequence <= ack_snapshot) return;
+        // a snapshot per tick when the server keeps up, a gap is loss or
+        // a server that fell behind
+        if (stats.snapshots == 0) {
+            stats.first_tick = state.sequence;
+        } else {
+            stats.snapshots_missed += state.sequence - stats.last_tick - 1;
+        }
+        stats.last_tick = state.sequence;
+        stats.snapshots++;
+        ack_snapshot = server_tick = state.sequence;
+        if (clock.synced()) {
+            state.timestamp =
+                clock.expand_server_millis((uint32_t)state.timestamp, now);
+            clock.on_snapshot(state.sequence, state.timestamp, now);
+        }
+
+        auto acked = std::upper_bound(
+            unacknowledged.begin(),
+            unacknowledged.end(),
+            state.input_ack,
+            [](uint32_t ack, const InputPacket &input) {
+                return ack < input.sequence;
+            });
+        unacknowledged.erase(unacknowledged.begin(), acked);
+        if (const PlayerState *player = find_player(state, client_id)) {
+            position = {player->rect.x, player->rect.y};
+        }
+    } else if (header.type == PacketType::PING) {
+        PingPacket pong;
+        if (!deserialize(packet, len, pong)) return;
+        clock.on_pong(pong, now);
+        stats.rtts.push_back((uint32_t)now - pong.client_time);
+    } else if (header.type == PacketType::CLIENT_CONNECT) {
+        ClientPacket ack;
+        if (!deserialize(packet, len, ack) || connected()) return;
+        client_id = header.sender;
+        server_tick = ack.tick;
+    } else if (header.type == PacketType::CLIENT_DISCONNECT) {
+        gone = true;
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef HIDO_LOADGEN_BOT_HPP
+#define HIDO_LOADGEN_BOT_HPP
+
+#include <netinet/in.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "client/clock_sync.hpp"
+#include "network.hpp"
+#include "packet_batch.hpp"
+#include "snapshot.hpp"
+
+/**
+ * What one bot saw over a run
+ */
+struct BotStats {
+    size_t snapshots = 0;
+    uint32_t first_tick = 0, last_tick = 0;
+    // ticks without a snapshot, lost on the way or skipped by a server
+    // catching up after a slow tick
+    size_t snapshots_missed = 0;
+    size_t bytes_sent = 0, bytes_received = 0;
+    size_t packets_sent = 0, packets_received = 0;
+    std::vector<uint32_t> rtts;
+};
+
+/**
+ * A scripted headless client. It speaks the same protocol as Client,
+ * without rendering or prediction: it wanders, shoots, acks snapshots and
+ * pings like a player would.
+ */
+class Bot {
+  public:
+    /**
+     * @param server address every datagram goes to
+     * @param seed for the bot's script
+     */
+    Bot(const sockaddr_in &server, uint32_t seed);
+    ~Bot();
+    Bot(const Bot &) = delete;
+    Bot &operator=(const Bot &) = delete;
+
+    /**
+     * @returns false if the socket couldn't be opened
+     */
+    bool ok() const {
+        return sock >= 0;
+    }
+    int get_sock() const {
+        return sock;
+    }
+    bool connected() const {
+        return client_id >= 0;
+    }
+    bool disconnected() const {
+        return gone;
+    }
+    /**
+     * Starts counting from zero, to leave out connecting
+     */
+    void reset_stats() {
+        stats = {};
+    }
+
+    /**
+     * Runs one frame of the script and queues what it sends
+     * @param now millis
+     * @param disconnecting send disconnects instead of inputs
+     */
+    void frame(uint64_t now, bool disconnecting, SendBatch &batch);
+
+    /**
+     * Handles one datagram from the server
+     */
+    void receive(const Packet &packet, size_t len, uint64_t now);
+
+    const BotStats &get_stats() const {
+        return stats;
+    }
+
+  private:
+    void send(const void *data, size_t len, SendBatch &batch);
+
+    int sock = -1;
+    sockaddr_in server;
+    std::mt19937 rng;
+    BotStats stats;
+
+    int client_id = -1;
+    // the server acknowledged the disconnect
+    bool gone = false;
+    // newest server tick seen, sequences are expanded against it
+    uint32_t server_tick = 0;
+    uint32_t ack_snapshot = 0;
+    SnapshotDecoder decoder;
+    GameStatePacket state;
+    ClockSync clock;
+
+    // script
+    uint32_t input_sequence = 0;
+    std::vector<InputPacket> unacknowledged;
+    bool left_key = false, right_key = false, up_key = false, down_key = false;
+    // connects and disconnects are resent until acknowledged
+    uint64_t next_turn = 0, next_shot = 0, next_resend = 0;
+    Vector2 position{0.0f, 0.0f};
+};
+
+#endif // HIDO_LOADGEN_BOT_HPP
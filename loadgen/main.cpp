@@ -0,0 +1,213 @@
+#include <arpa/inet.h>
+#include <spdlog/spdlog.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bot.hpp"
+#include "network.hpp"
+#include "packet_batch.hpp"
+
+namespace {
+
+// bots that haven't connected by then are left out of the run
+constexpr uint64_t CONNECT_TIMEOUT = 5000;
+// how long disconnects are retried for at the end
+constexpr uint64_t DISCONNECT_TIMEOUT = 1000;
+
+uint32_t percentile(const std::vector<uint32_t> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    return sorted[std::min<size_t>(sorted.size() * p, sorted.size() - 1)];
+}
+
+void report(const std::vector<std::unique_ptr<Bot>> &bots, double seconds) {
+    size_t connected = 0, snapshots = 0, missed = 0, packets_sent = 0,
+           packets_received = 0;
+    double min_rate = 1e9, tick_rate = 0.0;
+    double down = 0.0, up = 0.0, max_down = 0.0;
+    std::vector<uint32_t> rtts;
+    for (const auto &bot : bots) {
+        if (!bot->connected()) continue;
+        const BotStats &stats = bot->get_stats();
+        connected++;
+        snapshots += stats.snapshots;
+        missed += stats.snapshots_missed;
+        packets_sent += stats.packets_sent;
+        packets_received += stats.packets_received;
+        min_rate = std::min(min_rate, stats.snapshots / seconds);
+        tick_rate += (stats.last_tick - stats.first_tick) / seconds;
+        down += stats.bytes_received / seconds / 1024.0;
+        up += stats.bytes_sent / seconds / 1024.0;
+        max_down = std::max(max_down, stats.bytes_received / seconds / 1024.0);
+        rtts.insert(rtts.end(), stats.rtts.begin(), stats.rtts.end());
+    }
+    if (connected == 0) {
+        spdlog::error("No bots connected.");
+        return;
+    }
+    std::sort(rtts.begin(), rtts.end());
+
+    spdlog::info("{} of {} bots connected, {:.1f}s measured.",
+                 connected,
+                 bots.size(),
+                 seconds);
+    spdlog::info("Server ticks: {:.1f}/s", tick_rate / connected);
+    spdlog::info("Snapshots per bot: {:.1f}/s, slowest bot {:.1f}/s",
+                 snapshots / seconds / connected,
+                 min_rate);
+    spdlog::info("Bandwidth per bot: {:.1f} KiB/s down (max {:.1f}), "
+                 "{:.1f} KiB/s up",
+                 down / connected,
+                 max_down,
+                 up / connected);
+    spdlog::info("RTT ms: p50 {} p90 {} p99 {} max {} ({} pings)",
+                 percentile(rtts, 0.5),
+                 percentile(rtts, 0.9),
+                 percentile(rtts, 0.99),
+                 rtts.empty() ? 0 : rtts.back(),
+                 rtts.size());
+    spdlog::info("Ticks without a snapshot: {} of {} ({:.2f}%)",
+                 missed,
+                 snapshots + missed,
+                 100.0 * missed / std::max<size_t>(snapshots + missed, 1));
+    spdlog::info("Datagrams: {} sent, {} received",
+                 packets_sent,
+                 packets_received);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc > 5) {
+        spdlog::error(
+            "Invalid usage: ./hido-loadgen [bots] [seconds] [address] [port]");
+        return -1;
+    }
+    size_t bot_count = 100;
+    double seconds = 10.0;
+    std::string addr = "127.0.0.1";
+    int port = PORT;
+    try {
+        if (argc > 1) bot_count = std::stoul(argv[1]);
+        if (argc > 2) seconds = std::stod(argv[2]);
+        if (argc > 3) addr = argv[3];
+        if (argc > 4) port = std::stoi(argv[4]);
+    } catch (std::invalid_argument const &e) {
+        spdlog::error("std::invalid argument: {}", e.what());
+        return -1;
+    } catch (std::out_of_range const &e) {
+        spdlog::error("std::out_of_range: {}", e.what());
+        return -1;
+    }
+
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    if (inet_pton(AF_INET, addr.c_str(), &server.sin_addr) != 1) {
+        spdlog::error("Invalid address {}.", addr);
+        return -1;
+    }
+
+    // every bot socket and the frame timer share one epoll set
+    int epfd = epoll_create1(0);
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = UINT64_MAX;
+    if (epfd < 0 || tfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0) {
+        spdlog::error("Error creating frame timer.");
+        return -1;
+    }
+    std::vector<std::unique_ptr<Bot>> bots;
+    for (size_t i = 0; i < bot_count; ++i) {
+        auto bot = std::make_unique<Bot>(server, i + 1);
+        ev.data.u64 = i;
+        if (!bot->ok() ||
+            epoll_ctl(epfd, EPOLL_CTL_ADD, bot->get_sock(), &ev) < 0) {
+            spdlog::error("Could only open {} bots.", i);
+            break;
+        }
+        bots.push_back(std::move(bot));
+    }
+    // bots step together once per frame, like clients running at FPS
+    itimerspec spec{};
+    spec.it_interval.tv_nsec = TICK_INTERVAL * 1000000L;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(tfd, 0, &spec, nullptr);
+    spdlog::info("Running {} bots against {}:{} for {}s.",
+                 bots.size(),
+                 addr,
+                 port,
+                 seconds);
+
+    RecvBatch recv_batch;
+    SendBatch send_batch;
+    const size_t MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+
+    // connect, measure, then disconnect
+    uint64_t start = get_now_millis();
+    uint64_t measure_start = 0, measure_end = 0, stop = 0;
+    while (true) {
+        int n_ready = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n_ready < 0) continue;
+        uint64_t now = get_now_millis();
+        bool frame = false;
+        for (int i = 0; i < n_ready; ++i) {
+            if (events[i].data.u64 == UINT64_MAX) {
+                uint64_t expirations = 0;
+                frame = read(tfd, &expirations, sizeof(expirations)) > 0;
+                continue;
+            }
+            Bot &bot = *bots[events[i].data.u64];
+            // drain the socket in batches
+            int n;
+            do {
+                n = recv_batch.receive(bot.get_sock());
+                for (int j = 0; j < n; ++j) {
+                    bot.receive(
+                        recv_batch.packet(j), recv_batch.length(j), now);
+                }
+            } while (n == (int)PACKET_BATCH_SIZE);
+        }
+        if (!frame) continue;
+
+        if (measure_start == 0) {
+            bool all_connected = std::all_of(
+                bots.begin(), bots.end(), [](const auto &bot) {
+                    return bot->connected();
+                });
+            if (all_connected || now - start >= CONNECT_TIMEOUT) {
+                measure_start = now;
+                measure_end = now + seconds * 1000;
+                for (auto &bot : bots) bot->reset_stats();
+            }
+        } else if (stop == 0 && now >= measure_end) {
+            report(bots, (now - measure_start) / 1000.0);
+            stop = now + DISCONNECT_TIMEOUT;
+        }
+        bool disconnecting = stop != 0;
+        if (disconnecting) {
+            bool all_gone = std::all_of(
+                bots.begin(), bots.end(), [](const auto &bot) {
+                    return bot->disconnected();
+                });
+            if (all_gone || now >= stop) break;
+        }
+        // each bot's datagrams for the frame go out in one sendmmsg
+        for (auto &bot : bots) {
+            bot->frame(now, disconnecting, send_batch);
+            send_batch.flush(bot->get_sock());
+        }
+    }
+
+    close(tfd);
+    close(epfd);
+    return 0;
+}
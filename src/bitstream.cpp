@@ -0,0 +1,79 @@
+#include "bitstream.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+uint32_t Quantization::encode(float value) const {
+    uint32_t max_steps = (uint32_t)((max - min) / precision);
+    if (std::isnan(value)) value = min;
+    float steps = std::round((std::clamp(value, min, max) - min) / precision);
+    return std::min((uint32_t)steps, max_steps);
+}
+
+float Quantization::decode(uint32_t value) const {
+    return std::min(min + value * precision, max);
+}
+
+BitWriter::BitWriter(void *data, size_t capacity)
+    : data((uint8_t *)data), capacity_bits(capacity * 8) {}
+
+void BitWriter::write_bits(uint32_t value, uint32_t bits) {
+    if (pos + bits > capacity_bits) {
+        overflow = true;
+        return;
+    }
+    // byte at a time, partial bytes are merged with what's there
+    while (bits > 0) {
+        size_t byte = pos / 8;
+        uint32_t offset = pos % 8;
+        uint32_t n = std::min(8 - offset, bits);
+        uint8_t mask = ((1u << n) - 1) << offset;
+        data[byte] = (data[byte] & ~mask) | ((value << offset) & mask);
+        value >>= n;
+        bits -= n;
+        pos += n;
+    }
+}
+
+void BitWriter::write_float(float value) {
+    uint32_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    write_bits(raw, 32);
+}
+
+void BitWriter::overwrite_bits(size_t bit_pos, uint32_t value, uint32_t bits) {
+    size_t end = pos;
+    pos = bit_pos;
+    write_bits(value, bits);
+    pos = std::max(pos, end);
+}
+
+BitReader::BitReader(const void *data, size_t len)
+    : data((const uint8_t *)data), len_bits(len * 8) {}
+
+uint32_t BitReader::read_bits(uint32_t bits) {
+    if (pos + bits > len_bits) {
+        overflow = true;
+        return 0;
+    }
+    uint32_t value = 0, shift = 0;
+    while (bits > 0) {
+        size_t byte = pos / 8;
+        uint32_t offset = pos % 8;
+        uint32_t n = std::min(8 - offset, bits);
+        uint32_t chunk = (data[byte] >> offset) & ((1u << n) - 1);
+        value |= chunk << shift;
+        shift += n;
+        bits -= n;
+        pos += n;
+    }
+    return value;
+}
+
+float BitReader::read_float() {
+    uint32_t raw = read_bits(32);
+    float value;
+    memcpy(&value, &raw, sizeof(value));
+    return value;
+}
@@ -0,0 +1,102 @@
+#ifndef HIDO_BITSTREAM_HPP
+#define HIDO_BITSTREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Maps a bounded float onto an unsigned integer of the fewest bits that
+ * keeps the given precision
+ */
+struct Quantization {
+    float min, max, precision;
+
+    constexpr uint32_t bits() const {
+        uint64_t steps = (uint64_t)((max - min) / precision);
+        uint32_t b = 0;
+        while ((1ull << b) <= steps) b++;
+        return b;
+    }
+
+    // clamps out of range values
+    uint32_t encode(float value) const;
+    float decode(uint32_t value) const;
+
+    /**
+     * @returns the value the receiver will decode, used to simulate with
+     * exactly what goes over the wire
+     */
+    float round(float value) const {
+        return decode(encode(value));
+    }
+};
+
+/**
+ * Writes values LSB first into a caller-owned byte buffer
+ */
+class BitWriter {
+  public:
+    BitWriter(void *data, size_t capacity);
+
+    void write_bits(uint32_t value, uint32_t bits);
+    void write_bool(bool value) {
+        write_bits(value, 1);
+    }
+    void write_float(float value);
+    void write_quantized(float value, const Quantization &q) {
+        write_bits(q.encode(value), q.bits());
+    }
+
+    /**
+     * Replaces bits written earlier, used to fill in counts after the fact
+     * @param bit_pos value returned by bit_position() before the write
+     */
+    void overwrite_bits(size_t bit_pos, uint32_t value, uint32_t bits);
+
+    size_t bit_position() const {
+        return pos;
+    }
+    // bytes touched so far, what goes on the wire
+    size_t bytes() const {
+        return (pos + 7) / 8;
+    }
+    bool overflowed() const {
+        return overflow;
+    }
+
+  private:
+    uint8_t *data;
+    size_t capacity_bits;
+    size_t pos = 0;
+    bool overflow = false;
+};
+
+/**
+ * Reads values written by BitWriter, reading past the end returns zeros and
+ * marks the reader as failed
+ */
+class BitReader {
+  public:
+    BitReader(const void *data, size_t len);
+
+    uint32_t read_bits(uint32_t bits);
+    bool read_bool() {
+        return read_bits(1) != 0;
+    }
+    float read_float();
+    float read_quantized(const Quantization &q) {
+        return q.decode(read_bits(q.bits()));
+    }
+
+    bool ok() const {
+        return !overflow;
+    }
+
+  private:
+    const uint8_t *data;
+    size_t len_bits;
+    size_t pos = 0;
+    bool overflow = false;
+};
+
+#endif // HIDO_BITSTREAM_HPP
@@ -10,16 +10,18 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <memory>
-#include <mutex>
 #include <thread>
+#include <utility>
 
 #include "map/map.hpp"
 #include "map/map_renderer.hpp"
 #include "network.hpp"
 #include "state/bullet.hpp"
 #include "state/player.hpp"
+#include "trace.hpp"
 
 Client::Client(const std::string &addr, uint32_t port, const std::string &name)
     : name(name) {
@@ -49,6 +51,7 @@ void Client::run() {
     using namespace std::chrono_literals;
     if (!running) return;
     spdlog::info("Running client.");
+    trace_thread_name("render");
     std::thread listening{[&]() { listen_thread(); }};
 
     // send connecting messages
@@ -73,18 +76,25 @@ void Client::run() {
     map = std::make_unique<GameMap>("./res/map/map1.tmx", "./res/map");
     MapRenderer map_renderer(map.get(), "./res/map");
     while (!WindowShouldClose()) {
-        // network updates
-        float dt = GetFrameTime();
+        trace_poll();
+        TraceZone frame("frame");
+        // take in whatever the server sent since last frame
+        receive_snapshots();
+
         // simulate locally
-        InputPacket input = get_input();
-        unacknowledged.push_back(input);
         {
-            std::lock_guard<std::mutex> guard(state_mutex);
+            TraceZone zone("prediction");
+            InputPacket input = get_input();
+            unacknowledged.push_back(input);
+            // the server skips anything older once it sees this one
+            if (unacknowledged.size() > INPUT_QUEUE_SIZE) {
+                unacknowledged.erase(unacknowledged.begin());
+            }
             // if we already initialized position
             if (client_id != -1) {
                 Vector2 vel{(input.right - input.left) * PLAYER_SPEED,
                             (input.down - input.up) * PLAYER_SPEED};
-                player_update(local_player, vel, dt, *map);
+                player_update(local_player, vel, input.dt, *map);
             }
             // update camera for next frame
             camera.target.x +=
@@ -97,8 +107,8 @@ void Client::run() {
                 0.05f;
         }
 
-        // get input and send packet
-        send_input_packet(input);
+        // send it along with the last few the server hasn't acknowledged
+        send_input_batch();
 
         // render
         BeginDrawing();
@@ -106,21 +116,23 @@ void Client::run() {
         BeginMode2D(camera);
         map_renderer.render();
 
-        // render bullets
-        if (bullet_state_buffer.size() >= 2) {
-            uint64_t render_time = get_render_time();
-            render_bullets(render_time);
-        }
-
-        // render other players
-        if (game_state_buffer.size() >= 2) {
-            uint64_t render_time = get_render_time();
-            render_state(render_time);
+        // render bullets and other players
+        StateSample<GameStatePacket> sample;
+        uint64_t render_time = clock.render_time(get_now_millis());
+        if (game_state_buffer.sample(render_time, sample)) {
+            const GameStatePacket &a = *sample.a, &b = *sample.b;
+            float offset = sample.t * (b.sequence - a.sequence);
+            render_tick = a.sequence + (uint32_t)offset;
+            render_frac = offset - std::floor(offset);
+            render_bullets(sample);
+            render_state(sample);
         }
         // render this player
         player_render(local_player, player_texture, health_bar_texture, WHITE);
 
         EndMode2D();
+        // swaps buffers and waits out the rest of the frame
+        TraceZone zone("end_drawing");
         EndDrawing();
     }
     // broadcast disconnect
@@ -135,32 +147,21 @@ void Client::run() {
     spdlog::info("Client shutting down.");
 }
 
-void Client::render_state(uint64_t render_time) {
-    std::lock_guard<std::mutex> state_lock_guard(state_mutex);
-    // trim state buffer
-    // force second element to be after render_time
-    game_state_buffer.remove_unused(render_time);
-
+void Client::render_state(const StateSample<GameStatePacket> &sample) {
+    TraceZone zone("render_state");
     // draw the lerped states
-    auto &a = game_state_buffer[0];
-    auto &b = game_state_buffer[1];
-    float t = (render_time - a.header.timestamp) /
-              float(b.header.timestamp - a.header.timestamp);
+    const GameStatePacket &a = *sample.a, &b = *sample.b;
+    float t = sample.t;
 
     // draw other players in different color
-    for (size_t i = 0; i < b.num_players; ++i) {
-        const PlayerState &player_b = b.players[i];
+    for (const PlayerState &player_b : b.players) {
         // try find this player in previous frame (A)
-        auto itr = std::find_if(a.players.begin(),
-                                a.players.end(),
-                                [&player_b](const PlayerState &state) {
-                                    return state.id == player_b.id;
-                                });
+        const PlayerState *player_a = player_tracks.find(a, player_b.id);
         // default is latest frame (B)
         PlayerState resolved_player_state = player_b;
         // if existed on last frame, lerp
-        if (itr != a.players.end()) {
-            resolved_player_state = player_lerp(*itr, player_b, t);
+        if (player_a != nullptr) {
+            resolved_player_state = player_lerp(*player_a, player_b, t);
         }
         // draw others in red
         Color color = {207, 87, 80, 255};
@@ -172,42 +173,91 @@ void Client::render_state(uint64_t render_time) {
     }
 }
 
-void Client::render_bullets(uint64_t render_time) {
-    std::lock_guard<std::mutex> state_lock_guard(state_mutex);
-    bullet_state_buffer.remove_unused(render_time);
-    auto &a = bullet_state_buffer[0];
-    auto &b = bullet_state_buffer[1];
-    for (size_t i = 0; i < b.num_bullets; ++i) {
-        auto &bullet_b = b.bullets[i];
-        // find in previous frame (A)
-        auto itr = std::find_if(b.bullets.begin(),
-                                b.bullets.end(),
-                                [&bullet_b](BulletPacket &bp) -> bool {
-                                    return bullet_b.id == bp.id;
-                                });
+void Client::render_bullets(const StateSample<GameStatePacket> &sample) {
+    TraceZone zone("render_bullets");
+    const GameStatePacket &a = *sample.a, &b = *sample.b;
+    // bullets are placed from where they were fired, at the tick between
+    // the two snapshots we're rendering
+
+    // everything in A or B, including what despawned in between
+    for (const BulletTracks::Track &track : bullet_tracks.get_tracks()) {
+        if (track.first_seen > b.sequence || track.last_seen < a.sequence) {
+            continue;
+        }
+        const BulletState &bullet = track.state;
+        // the fraction never crosses a whole tick, comparing ticks is enough
+        if (render_tick < bullet.spawn_tick ||
+            render_tick >= bullet.impact_tick) {
+            continue;
+        }
         Color color = WHITE;
         // enemy bullets
-        if (client_id >= 0 && b.bullets[i].sender != client_id) {
+        if (client_id >= 0 && bullet.sender != client_id) {
             color = Color{50, 20, 235, 255};
         }
-        // if found
-        if (itr != b.bullets.end()) {
-            float t = (render_time - a.header.timestamp) /
-                      float(b.header.timestamp - a.header.timestamp);
-            bullet_render(
-                Vector2Lerp(itr->pos, bullet_b.pos, t), bullet_texture, color);
-        } else {
-            bullet_render(bullet_b.pos, bullet_texture, color);
-        }
+        bullet_render(bullet_position(bullet, render_tick, render_frac),
+                      bullet_texture,
+                      color);
+    }
+}
+
+void Client::receive_snapshots() {
+    TraceZone zone("receive_snapshots");
+    while (GameStatePacket *queued = snapshot_queue.front()) {
+        // trade buffers with the evicted slot instead of copying, both
+        // sides keep their capacity
+        GameStatePacket &gsp = game_state_buffer.push();
+        std::swap(gsp, *queued);
+        snapshot_queue.pop();
+
+        player_tracks.add(gsp);
+        bullet_tracks.add(gsp, game_state_buffer[0].sequence);
+        reconcile(gsp);
+    }
+}
+
+void Client::reconcile(const GameStatePacket &gsp) {
+    // find player packet
+    const PlayerState *player = player_tracks.find(gsp, client_id);
+    // if there's no packet, just ignore this
+    if (player == nullptr) return;
+
+    // authoritative server overwrites true position
+    local_player = *player;
+
+    // delete all inputs the server already applied
+    auto unacknowledged_range =
+        std::upper_bound(unacknowledged.begin(),
+                         unacknowledged.end(),
+                         gsp.input_ack,
+                         [](uint32_t ack, const InputPacket &input) {
+                             return ack < input.sequence;
+                         });
+    unacknowledged.erase(unacknowledged.begin(), unacknowledged_range);
+
+    // reconstruct player position
+    for (const InputPacket &input : unacknowledged) {
+        Vector2 vel{(input.right - input.left) * PLAYER_SPEED,
+                    (input.down - input.up) * PLAYER_SPEED};
+        player_update(local_player, vel, input.dt, *map);
     }
 }
+
 void Client::listen_thread() {
+    trace_thread_name("listen");
     Packet packet;
+    // decoded into when the queue is full
+    GameStatePacket gsp;
+    // newest server tick we know of, sequences are expanded against it
+    uint32_t server_tick = 0;
     pollfd fds[1];
     fds[0].fd = sock;
     fds[0].events = POLLIN;
 
     while (running) {
+        if (!connecting && clock.ping_due(get_now_millis())) {
+            send_ping_packet(get_now_millis());
+        }
         // non-blocking allows disconnect
         if (poll(fds, 1, 10) < 0) {
             spdlog::error("Polling error.");
@@ -218,71 +268,62 @@ void Client::listen_thread() {
                 sockaddr_in from{};
                 socklen_t len = sizeof(from);
                 // expect max size
-                if (recvfrom(sock,
-                             packet.data(),
-                             packet.size(),
-                             MSG_DONTWAIT,
-                             (sockaddr *)&from,
-                             &len) <= 0) {
+                ssize_t n = recvfrom(sock,
+                                     packet.data(),
+                                     packet.size(),
+                                     MSG_DONTWAIT,
+                                     (sockaddr *)&from,
+                                     &len);
+                if (n <= 0) {
                     break;
                 }
-                PacketHeader *header = get_header(packet);
-                if (header->type == PacketType::GAME_STATE) {
-                    GameStatePacket *gsp =
-                        get_packet_data<GameStatePacket>(packet);
-                    // client_id = gsp->client_id;
-
-                    std::lock_guard<std::mutex> lock_guard(state_mutex);
-                    game_state_buffer.push_back(*gsp);
-
-                    // find player packet
-                    auto end = gsp->players.begin() + gsp->num_players;
-                    auto itr = std::find_if(
-                        gsp->players.begin(), end, [&](PlayerState &ps) {
-                            return ps.id == client_id;
-                        });
-                    // if there's no packet, just ignore this
-                    if (itr == end) continue;
-
-                    // authoritative server overwrites true position
-                    local_player = *itr;
-
-                    // delete all inputs before last_acknowledged
-                    uint64_t last_acknowledged = gsp->header.timestamp;
-                    InputPacket target_last;
-                    target_last.header.timestamp = last_acknowledged;
-                    auto unacknowledged_range = std::upper_bound(
-                        unacknowledged.begin(),
-                        unacknowledged.end(),
-                        target_last,
-                        [](const InputPacket &a, const InputPacket &b) {
-                            return a.header.timestamp < b.header.timestamp;
-                        });
-                    unacknowledged.erase(unacknowledged.begin(),
-                                         unacknowledged_range);
-
-                    // reconstruct player position
-                    for (const InputPacket &input : unacknowledged) {
-                        Vector2 vel{(input.right - input.left) * PLAYER_SPEED,
-                                    (input.down - input.up) * PLAYER_SPEED};
-                        player_update(local_player, vel, input.dt, *map);
+                PacketHeader header;
+                if (!peek_header(packet, n, header)) continue;
+                trace_instant(packet_type_name(header.type), n);
+                TraceZone zone("handle_packet");
+                if (header.type == PacketType::GAME_STATE) {
+                    // decode straight into the queue, the decoder has to see
+                    // every snapshot even when the render thread is full
+                    GameStatePacket *slot = snapshot_queue.write_slot();
+                    GameStatePacket &out = slot != nullptr ? *slot : gsp;
+                    // rebuild the full state once every fragment arrived
+                    if (!snapshot_decoder.decode(
+                            packet, n, server_tick, out)) {
+                        continue;
                     }
-                } else if (header->type == PacketType::BULLET) {
-                    BulletStatePacket *bsp =
-                        get_packet_data<BulletStatePacket>(packet);
-                    std::lock_guard<std::mutex> lock_guard(state_mutex);
-                    bullet_state_buffer.push_back(*bsp);
+                    // drop late snapshots, the buffer must stay ordered
+                    if (out.sequence <= ack_snapshot) continue;
+                    ack_snapshot = out.sequence;
+                    server_tick = out.sequence;
+                    trace_instant("snapshot_decoded", out.sequence);
+                    // timestamps are meaningless until we know the server's
+                    // clock, just keep decoding until then
+                    if (!clock.synced()) continue;
+                    uint64_t now = get_now_millis();
+                    out.timestamp = clock.expand_server_millis(
+                        (uint32_t)out.timestamp, now);
+                    clock.on_snapshot(out.sequence, out.timestamp, now);
+                    // hand it to the render thread, if it fell that far
+                    // behind this snapshot is skipped
+                    if (slot != nullptr) snapshot_queue.push();
+                } else if (header.type == PacketType::PING) {
+                    PingPacket pong;
+                    if (!deserialize(packet, n, pong)) continue;
+                    clock.on_pong(pong, get_now_millis());
                 }
                 // this means the server acknowledged it
-                else if (header->type == PacketType::CLIENT_DISCONNECT) {
+                else if (header.type == PacketType::CLIENT_DISCONNECT) {
                     running = false;
                     break;
                 }
                 // this means the server acknowledged it
-                else if (header->type == PacketType::CLIENT_CONNECT) {
+                else if (header.type == PacketType::CLIENT_CONNECT) {
+                    ClientPacket ack;
+                    if (!deserialize(packet, n, ack)) continue;
+                    if (connecting) server_tick = ack.tick;
                     connecting = false;
                     // IMPORTANT: save ID, now client knows who it is
-                    client_id = header->sender;
+                    client_id = header.sender;
                 }
             }
         }
@@ -292,9 +333,11 @@ void Client::listen_thread() {
 void Client::send_connect_packet() {
     ClientPacket p{.header = {.type = PacketType::CLIENT_CONNECT}};
     strcpy(p.name, name.c_str());
+    Packet packet;
+    size_t len = serialize(p, packet);
     sendto(sock,
-           &p,
-           sizeof(ClientPacket),
+           packet.data(),
+           len,
            0,
            (sockaddr *)&serv_addr,
            sizeof(serv_addr));
@@ -302,19 +345,47 @@ void Client::send_connect_packet() {
 
 void Client::send_disconnect_packet() {
     ClientPacket p{.header = {.type = PacketType::CLIENT_DISCONNECT}};
+    Packet packet;
+    size_t len = serialize(p, packet);
     sendto(sock,
-           &p,
-           sizeof(ClientPacket),
+           packet.data(),
+           len,
            0,
            (sockaddr *)&serv_addr,
            sizeof(serv_addr));
 }
 
-void Client::send_input_packet(const InputPacket &input) {
-    // send actual packet
+void Client::send_ping_packet(uint64_t now) {
+    PingPacket p{.header = {.type = PacketType::PING, .sender = client_id}};
+    p.client_time = now;
+    Packet packet;
+    size_t len = serialize(p, packet);
+    sendto(sock,
+           packet.data(),
+           len,
+           0,
+           (sockaddr *)&serv_addr,
+           sizeof(serv_addr));
+}
+
+void Client::send_input_batch() {
+    TraceZone zone("send_input_batch");
+    InputBatch batch;
+    batch.header.type = PacketType::INPUT;
+    batch.header.sender = client_id;
+    batch.ack_snapshot = ack_snapshot;
+    // resend the last few the server hasn't acknowledged with it
+    batch.count =
+        std::min(clock.input_redundancy(), unacknowledged.size());
+    std::copy(unacknowledged.end() - batch.count,
+              unacknowledged.end(),
+              batch.inputs.begin());
+
+    Packet packet;
+    size_t len = serialize(batch, packet);
     sendto(sock,
-           &input,
-           sizeof(InputPacket),
+           packet.data(),
+           len,
            0,
            (sockaddr *)&serv_addr,
            sizeof(serv_addr));
@@ -330,9 +401,9 @@ InputPacket Client::get_input() {
     // convert mouse position to world coordinates
     input.mouse_pos = GetScreenToWorld2D(GetMousePosition(), camera);
 
-    input.header.type = PacketType::INPUT;
-    input.header.timestamp = get_now_millis();
-    input.header.sender = client_id;
-    input.dt = GetFrameTime();
+    input.sequence = ++input_sequence;
+    // simulate with exactly what the server receives
+    input.dt = DT_QUANTIZATION.round(GetFrameTime());
+    input.view_tick = render_tick + (render_frac >= 0.5f);
     return input;
 }
@@ -5,11 +5,15 @@
 #include <raylib.h>
 
 #include <atomic>
-#include <mutex>
+#include <memory>
 #include <string>
 
+#include "client/clock_sync.hpp"
+#include "client/entity_tracks.hpp"
 #include "map/map.hpp"
 #include "network.hpp"
+#include "snapshot.hpp"
+#include "spsc_queue.hpp"
 #include "state/player.hpp"
 #include "state_buffer.hpp"
 
@@ -20,13 +24,16 @@ class Client {
     void run();
 
   private:
-    void render_state(uint64_t render_time);
-    void render_bullets(uint64_t render_time);
+    void render_state(const StateSample<GameStatePacket> &sample);
+    void render_bullets(const StateSample<GameStatePacket> &sample);
+    void receive_snapshots();
+    void reconcile(const GameStatePacket &gsp);
 
     void listen_thread();
     void send_connect_packet();
     void send_disconnect_packet();
-    void send_input_packet(const InputPacket &input);
+    void send_input_batch();
+    void send_ping_packet(uint64_t now);
     InputPacket get_input();
 
     int sock = 0;
@@ -35,19 +42,36 @@ class Client {
     std::string name;
 
     constexpr static int WIDTH = 1080, HEIGHT = 720;
+    // snapshots kept to interpolate between, a few times the delay
+    constexpr static size_t SNAPSHOT_BUFFER_SIZE = 32;
 
     int client_id = -1;
-    StateBuffer<GameStatePacket> game_state_buffer;
-    StateBuffer<BulletStatePacket> bullet_state_buffer;
-
-    std::mutex state_mutex;
+    // everything below is owned by the render thread, snapshots get there
+    // through the queue so neither thread ever blocks the other
+    StateBuffer<GameStatePacket, SNAPSHOT_BUFFER_SIZE> game_state_buffer;
+    // entities of the buffered snapshots by id
+    PlayerTracks player_tracks{SNAPSHOT_BUFFER_SIZE};
+    BulletTracks bullet_tracks;
+    // reassembles snapshots, only touched by the listen thread
+    SnapshotDecoder snapshot_decoder;
+    std::atomic<uint32_t> ack_snapshot = 0;
+    // decoded snapshots from the listen thread to the render thread
+    SpscQueue<GameStatePacket, 16> snapshot_queue;
+    // server clock and interpolation delay
+    ClockSync clock;
+    // server tick others were last rendered at and how far past it, ticks
+    // outgrow a float's precision within hours
+    uint32_t render_tick = 0;
+    float render_frac = 0.0f;
 
     // textures
     Texture player_texture, bullet_texture, health_bar_texture;
     Camera2D camera;
 
     PlayerState local_player;
-    std::vector<InputPacket> unacknowledged; // increasing order of timestamps
+    // increasing order of sequence, at most INPUT_QUEUE_SIZE
+    std::vector<InputPacket> unacknowledged;
+    uint32_t input_sequence = 0;
     std::unique_ptr<GameMap> map;
 };
 
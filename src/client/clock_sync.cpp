@@ -0,0 +1,95 @@
+#include "clock_sync.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// how many jitters of slack the delay keeps over the mean latency
+constexpr float JITTER_MARGIN = 4.0f;
+// snapshots the loss rate is averaged over
+constexpr uint32_t LOSS_WINDOW = 64;
+}
+
+bool ClockSync::ping_due(uint64_t now) {
+    uint64_t interval =
+        pings_sent < SYNC_PINGS ? SYNC_PING_INTERVAL : PING_INTERVAL;
+    if (pings_sent > 0 && now - last_ping < interval) return false;
+    last_ping = now;
+    pings_sent++;
+    return true;
+}
+
+void ClockSync::on_pong(const PingPacket &pong, uint64_t now) {
+    // both clocks wrap at 32 bits, differences are still exact
+    uint32_t round_trip = (uint32_t)now - pong.client_time;
+    // a pong from before a wrap or a long stall tells us nothing
+    if (round_trip > MAX_INTERPOLATION_DELAY * 4) return;
+    // the server stamped it halfway through the round trip
+    int32_t sample_offset =
+        pong.server_time - (pong.client_time + round_trip / 2);
+    samples[next_sample] = {round_trip, sample_offset};
+    next_sample = (next_sample + 1) % CLOCK_SAMPLES;
+    sample_count = std::min(sample_count + 1, CLOCK_SAMPLES);
+
+    // the fastest round trip was the least delayed by queues, so its
+    // midpoint guess is the most accurate
+    const Sample *best = &samples[0];
+    for (size_t i = 1; i < sample_count; ++i) {
+        if (samples[i].rtt < best->rtt) best = &samples[i];
+    }
+    offset.store(best->offset, std::memory_order_relaxed);
+    rtt.store(round_trip, std::memory_order_relaxed);
+}
+
+void ClockSync::on_snapshot(uint32_t sequence,
+                            uint64_t timestamp,
+                            uint64_t now) {
+    // how old the snapshot is by the server's clock when we get it
+    float age = (int64_t)(server_now(now) - timestamp);
+    if (last_sequence == 0) {
+        mean_age = age;
+    }
+    // RFC 3550 style running averages
+    jitter += (std::abs(age - mean_age) - jitter) / 16.0f;
+    mean_age += (age - mean_age) / 16.0f;
+    // lost snapshots in a row, jumps to a burst and forgets it slowly
+    float smooth_burst = burst.load(std::memory_order_relaxed);
+    if (last_sequence != 0) {
+        uint32_t gap = sequence - last_sequence;
+        smooth_burst = std::max<float>(
+            gap, smooth_burst + (1.0f - smooth_burst) / 64.0f);
+        // every snapshot in the gap but this one was lost
+        float lost = loss.load(std::memory_order_relaxed);
+        for (uint32_t i = 1; i <= std::min(gap, LOSS_WINDOW); ++i) {
+            lost += ((i < gap ? 1.0f : 0.0f) - lost) / LOSS_WINDOW;
+        }
+        loss.store(lost, std::memory_order_relaxed);
+        burst.store(smooth_burst, std::memory_order_relaxed);
+    }
+    last_sequence = sequence;
+
+    // the newest snapshot has to be ahead of the render time, even after a
+    // burst of losses and a late arrival
+    float target =
+        mean_age + smooth_burst * TICK_INTERVAL + JITTER_MARGIN * jitter;
+    target = std::clamp<float>(
+        target, TICK_INTERVAL, MAX_INTERPOLATION_DELAY);
+    // back off quickly, but creep closer slowly so it doesn't visibly jump
+    smooth_delay +=
+        (target - smooth_delay) / (target > smooth_delay ? 4.0f : 64.0f);
+    delay.store(std::lround(smooth_delay), std::memory_order_relaxed);
+}
+
+size_t ClockSync::input_redundancy() const {
+    // enough copies that an input is rarely lost in every datagram carrying
+    // it, about one in a thousand for independent losses, and always past
+    // the recent loss bursts
+    size_t redundancy = 2;
+    float lost = get_loss();
+    if (lost > 0.0f) {
+        redundancy = std::max<size_t>(
+            redundancy, std::ceil(std::log(1e-3f) / std::log(lost)));
+    }
+    redundancy = std::max<size_t>(redundancy, std::ceil(get_burst()) + 1);
+    return std::min(redundancy, MAX_INPUT_BATCH);
+}
@@ -0,0 +1,121 @@
+#ifndef HIDO_CLIENT_CLOCKSYNC_HPP
+#define HIDO_CLIENT_CLOCKSYNC_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "network.hpp"
+
+// pings go out quickly until the first few answers are in, then slowly
+constexpr uint64_t SYNC_PING_INTERVAL = 100, PING_INTERVAL = 1000;
+constexpr size_t SYNC_PINGS = 8;
+// round trips the offset is picked from
+constexpr size_t CLOCK_SAMPLES = 8;
+
+/**
+ * Estimates the server's clock from ping round trips, NTP style, and how far
+ * behind it to render so a snapshot to interpolate towards has almost always
+ * arrived. The delay covers the measured snapshot latency, its jitter, and
+ * bursts of lost snapshots, so each connection renders as recently as it can
+ * while staying smooth. The snapshot loss it measures also sizes the input
+ * batches.
+ *
+ * The listen thread feeds it, anything may read the estimates.
+ */
+class ClockSync {
+  public:
+    /**
+     * @returns true once per ping interval, the caller sends the ping
+     */
+    bool ping_due(uint64_t now);
+
+    /**
+     * @param pong a ping the server echoed back
+     * @param now when it arrived
+     */
+    void on_pong(const PingPacket &pong, uint64_t now);
+
+    /**
+     * @param sequence of a newly completed snapshot, newer than the last
+     * @param timestamp its server timestamp, see expand_server_millis
+     * @param now when it completed
+     */
+    void on_snapshot(uint32_t sequence, uint64_t timestamp, uint64_t now);
+
+    /**
+     * @returns true once a round trip has been measured
+     */
+    bool synced() const {
+        return sample_count > 0;
+    }
+
+    /**
+     * Server timestamps are only comparable with server_now() once expanded
+     * around it
+     */
+    uint64_t expand_server_millis(uint32_t low, uint64_t now) const {
+        return expand_millis(low, server_now(now));
+    }
+
+    /**
+     * The offset is only known modulo 32 bits, so the estimate is kept a
+     * wrap above our clock. Its low 32 bits are the server's and it never
+     * goes below zero however much longer the server has been up.
+     */
+    uint64_t server_now(uint64_t now) const {
+        return now + (1ull << 32) + offset.load(std::memory_order_relaxed);
+    }
+    /**
+     * @returns the server time to interpolate others at
+     */
+    uint64_t render_time(uint64_t now) const {
+        return server_now(now) - delay.load(std::memory_order_relaxed);
+    }
+    uint64_t get_delay() const {
+        return delay.load(std::memory_order_relaxed);
+    }
+    uint32_t get_rtt() const {
+        return rtt.load(std::memory_order_relaxed);
+    }
+    /**
+     * @returns fraction of snapshots lost, smoothed
+     */
+    float get_loss() const {
+        return loss.load(std::memory_order_relaxed);
+    }
+    /**
+     * @returns longest recent run of lost snapshots plus one, smoothed
+     */
+    float get_burst() const {
+        return burst.load(std::memory_order_relaxed);
+    }
+    /**
+     * @returns how many times each input should be sent, see InputBatch
+     */
+    size_t input_redundancy() const;
+
+  private:
+    struct Sample {
+        uint32_t rtt;
+        int64_t offset;
+    };
+    std::array<Sample, CLOCK_SAMPLES> samples;
+    size_t sample_count = 0, next_sample = 0;
+    uint64_t last_ping = 0;
+    size_t pings_sent = 0;
+
+    // snapshot latency as seen through the offset, smoothed
+    uint32_t last_sequence = 0;
+    float mean_age = 0.0f, jitter = 0.0f;
+    float smooth_delay = INTERPOLATION_DELAY;
+
+    // published for the render thread
+    std::atomic<int64_t> offset = 0;
+    std::atomic<uint64_t> delay = INTERPOLATION_DELAY;
+    std::atomic<uint32_t> rtt = 0;
+    std::atomic<float> loss = 0.0f, burst = 1.0f;
+};
+
+#endif // HIDO_CLIENT_CLOCKSYNC_HPP
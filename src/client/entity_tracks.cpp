@@ -0,0 +1,64 @@
+#include "entity_tracks.hpp"
+
+#include <algorithm>
+
+PlayerTracks::PlayerTracks(size_t history)
+    : history(history), entries(MAX_CLIENTS * history), sequences(history) {}
+
+void PlayerTracks::add(const GameStatePacket &gsp) {
+    sequences[next] = gsp.sequence;
+    for (uint32_t i = 0; i < gsp.players.size(); ++i) {
+        int id = gsp.players[i].id;
+        entries[entry_index(id, next)] = {gsp.sequence, id, i};
+    }
+    next = (next + 1) % history;
+}
+
+const PlayerState *PlayerTracks::find(const GameStatePacket &gsp,
+                                      int id) const {
+    if (id < 0 || gsp.sequence == 0) return nullptr;
+    // a handful of sequences, scanned in one go
+    auto itr = std::find(sequences.begin(), sequences.end(), gsp.sequence);
+    if (itr == sequences.end()) return nullptr;
+    const Entry &e = entries[entry_index(id, itr - sequences.begin())];
+    // a stale entry is from another snapshot or an older id in the slot
+    if (e.sequence != gsp.sequence || e.id != id) return nullptr;
+    return &gsp.players[e.index];
+}
+
+BulletTracks::BulletTracks() : slots(MAX_BULLETS, NO_TRACK) {
+    tracks.reserve(MAX_BULLETS);
+}
+
+void BulletTracks::add(const GameStatePacket &gsp, uint32_t oldest) {
+    for (size_t i = 0; i < tracks.size();) {
+        if (tracks[i].last_seen < oldest) {
+            remove_at(i);
+        } else {
+            ++i;
+        }
+    }
+    for (const BulletState &bullet : gsp.bullets) {
+        uint32_t &slot = slots[bullet.id & (MAX_BULLETS - 1)];
+        if (slot != NO_TRACK && tracks[slot].state.id == bullet.id) {
+            tracks[slot].last_seen = gsp.sequence;
+            continue;
+        }
+        // a reused slot leaves the old bullet tracked until it ages out,
+        // the slot just points at the newer one
+        slot = tracks.size();
+        tracks.push_back({bullet, gsp.sequence, gsp.sequence});
+    }
+}
+
+void BulletTracks::remove_at(uint32_t dense) {
+    uint32_t last = tracks.size() - 1;
+    uint32_t &slot = slots[tracks[dense].state.id & (MAX_BULLETS - 1)];
+    if (slot == dense) slot = NO_TRACK;
+    if (dense != last) {
+        uint32_t &moved = slots[tracks[last].state.id & (MAX_BULLETS - 1)];
+        if (moved == last) moved = dense;
+        tracks[dense] = tracks[last];
+    }
+    tracks.pop_back();
+}
@@ -0,0 +1,92 @@
+#ifndef HIDO_CLIENT_ENTITYTRACKS_HPP
+#define HIDO_CLIENT_ENTITYTRACKS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "network.hpp"
+#include "state/bullet.hpp"
+#include "state/player.hpp"
+
+/**
+ * Where every player sits in each of the last few snapshots, indexed by id
+ * slot and the order snapshots were added in, so sequences skipped by loss
+ * never land two buffered snapshots on the same entry
+ */
+class PlayerTracks {
+  public:
+    /**
+     * @param history how many of the newest snapshots can be looked up
+     */
+    explicit PlayerTracks(size_t history);
+
+    /**
+     * Records the players of a newly received snapshot
+     */
+    void add(const GameStatePacket &gsp);
+
+    /**
+     * @param gsp a snapshot passed to add() at most history snapshots ago
+     * @returns the player in gsp, nullptr if it wasn't in that snapshot
+     */
+    const PlayerState *find(const GameStatePacket &gsp, int id) const;
+
+  private:
+    struct Entry {
+        // 0 never names a snapshot
+        uint32_t sequence = 0;
+        int id = -1;
+        uint32_t index = 0;
+    };
+    size_t entry_index(int id, size_t snapshot) const {
+        return (id & (MAX_CLIENTS - 1)) * history + snapshot;
+    }
+
+    size_t history;
+    // history entries per id slot
+    std::vector<Entry> entries;
+    // sequence of the snapshot in each of the history positions
+    std::vector<uint32_t> sequences;
+    // position the next snapshot is added at
+    size_t next = 0;
+};
+
+/**
+ * Every bullet in the buffered snapshots, once each. Bullets never change
+ * after they spawn, so one record and the snapshots it was seen in is all
+ * interpolating them takes.
+ */
+class BulletTracks {
+  public:
+    struct Track {
+        BulletState state;
+        uint32_t first_seen, last_seen;
+    };
+
+    BulletTracks();
+
+    /**
+     * Records the bullets of a newly received snapshot
+     * @param oldest sequence of the oldest snapshot still buffered, bullets
+     * last seen before it are dropped
+     */
+    void add(const GameStatePacket &gsp, uint32_t oldest);
+
+    /**
+     * @returns every tracked bullet, in no particular order
+     */
+    const std::vector<Track> &get_tracks() const {
+        return tracks;
+    }
+
+  private:
+    void remove_at(uint32_t dense);
+    constexpr static uint32_t NO_TRACK = UINT32_MAX;
+
+    std::vector<Track> tracks;
+    // index into tracks by id slot, NO_TRACK when untracked
+    std::vector<uint32_t> slots;
+};
+
+#endif // HIDO_CLIENT_ENTITYTRACKS_HPP
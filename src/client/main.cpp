@@ -1,14 +1,25 @@
 #include <spdlog/spdlog.h>
 
+#include <csignal>
 #include <stdexcept>
 #include <string>
 
 #include "client.hpp"
 #include "network.hpp"
+#include "trace.hpp"
+
+namespace {
+
+void trace_handler(int) {
+    trace_request_flush();
+}
+
+} // namespace
 
 int main(int argc, char **argv) {
-    if (argc != 4) {
-        spdlog::error("Invalid usage: ./client <address> <port> <name>");
+    if (argc != 4 && argc != 5) {
+        spdlog::error(
+            "Invalid usage: ./client <address> <port> <name> [trace file]");
         return -1;
     }
     int port = 8080;
@@ -27,7 +38,17 @@ int main(int argc, char **argv) {
                       MAX_NAME_LENGTH);
         return -1;
     }
+    if (argc > 4 && !trace_start(argv[4], "client")) return -1;
+
+    // write out the trace so far on demand
+    struct sigaction sig_usr1_handler;
+    sig_usr1_handler.sa_handler = trace_handler;
+    sigemptyset(&sig_usr1_handler.sa_mask);
+    sig_usr1_handler.sa_flags = 0;
+    sigaction(SIGUSR1, &sig_usr1_handler, NULL);
+
     Client client(argv[1], port, name);
     client.run();
+    trace_stop();
     return 0;
 }
@@ -9,7 +9,26 @@ GameMap::GameMap(const std::string &file_path,
                  const std::string &tileset_path) {
     tmxparser::TmxReturn ret = parseFromFile(file_path, this, tileset_path);
     if (ret != tmxparser::TmxReturn::kSuccess) {
-        spdlog::error("Failed to load file: '{}'.");
+        spdlog::error("Failed to load file: '{}'.", file_path);
+        width = height = 0;
+        return;
+    }
+    bake_blocked();
+}
+
+void GameMap::bake_blocked() {
+    blocked.assign((width * height + 63) / 64, 0);
+    std::string out;
+    for (auto &layer : layerCollection) {
+        if (!layer.visible) continue;
+
+        const size_t n = std::min<size_t>(layer.tiles.size(), width * height);
+        for (unsigned int idx = 0; idx < n; ++idx) {
+            const tmxparser::Tile &tile = layer.tiles[idx];
+            if (tile.gid != 0 && contains_property(tile, "blocked", out)) {
+                blocked[idx / 64] |= uint64_t{1} << (idx % 64);
+            }
+        }
     }
 }
 
@@ -20,7 +39,7 @@ void GameMap::get_intersect_rects(
     get_intersect_rects(rect,
                         collided_tiles,
                         collided_tile_indices,
-                        [&](tmxparser::Tile *, unsigned int) { return false; });
+                        [&](tmxparser::Tile *, unsigned int) { return true; });
 }
 
 void GameMap::get_intersect_rects(
@@ -31,34 +50,14 @@ void GameMap::get_intersect_rects(
     // reset the output vectors
     collided_tiles.clear();
     collided_tile_indices.clear();
-    // make sure that the rectangle is not out of bounds
-    if (rect.x < 0.0f || rect.x + rect.width > (float)width * tileWidth ||
-        rect.y < 0.0f || rect.y + rect.height > (float)height * tileHeight) {
-        return;
-    }
-    // find bounds to search
-    unsigned int left, right, top, bottom;
-    left = std::max(std::floor(rect.x / tileWidth), 0.0f);
-    right =
-        std::min(std::floor((rect.x + rect.width) / tileWidth), width - 1.0f);
-    bottom = std::max(std::floor(rect.y / tileHeight), 0.0f);
-    top = std::min(std::floor((rect.y + rect.height) / tileHeight),
-                   height - 1.0f);
-    for (auto &layer : layerCollection) {
-        if (!layer.visible) continue;
-
-        for (unsigned int y = bottom; y <= top; y++) {
-            for (unsigned int x = left; x <= right; x++) {
-                // no flip since map orientation is correct in the tmx file
-                unsigned int tile_pos = y * layer.width + x;
-                tmxparser::Tile &tile = layer.tiles[tile_pos];
-                if (tile.gid != 0 && func(&tile, tile_pos)) {
-                    collided_tiles.push_back(&tile);
-                    collided_tile_indices.push_back(tile_pos);
-                }
+    for_each_intersecting_tile(
+        rect, [&](tmxparser::Tile &tile, unsigned int tile_pos) {
+            if (func(&tile, tile_pos)) {
+                collided_tiles.push_back(&tile);
+                collided_tile_indices.push_back(tile_pos);
             }
-        }
-    }
+            return false;
+        });
 }
 
 void GameMap::set_tile_rect(Rectangle &rect, unsigned int tile_idx) {
@@ -4,6 +4,9 @@
 #include <libtmx-parser/tmxparser.h>
 #include <raylib.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
@@ -23,6 +26,7 @@ class GameMap : public tmxparser::TmxMap {
      * with the given rect
      * @param collided_tile_indices vector of ints containing the location
      * of the collided tiles in the layer vector
+     * allocates, hot paths should use for_each_intersecting_tile
      */
     void get_intersect_rects(const Rectangle &rect,
                              std::vector<tmxparser::Tile *> &collided_tiles,
@@ -83,6 +87,96 @@ class GameMap : public tmxparser::TmxMap {
     virtual tmxparser::Tile &get_tile_at(int x, int y, int layer) {
         return layerCollection[layer].tiles[y * width + x];
     }
+
+    /**
+     * @param x coord in tile units
+     * @param y coord in tile units
+     * @returns if a tile on any visible layer at the given position has the
+     * "blocked" property, false outside the map
+     */
+    bool is_blocked(int x, int y) const {
+        if (x < 0 || y < 0 || x >= (int)width || y >= (int)height) {
+            return false;
+        }
+        unsigned int idx = y * width + x;
+        return (blocked[idx / 64] >> (idx % 64)) & 1;
+    }
+
+    /**
+     * @param rect test rect in pixels
+     * @returns if rect overlaps a blocked tile, touching edges don't count
+     */
+    bool rect_blocked(const Rectangle &rect) const {
+        int left, top, right, bottom;
+        if (!tile_range(rect, left, top, right, bottom)) return false;
+        for (int y = top; y <= bottom; ++y) {
+            for (int x = left; x <= right; ++x) {
+                unsigned int idx = y * width + x;
+                if ((blocked[idx / 64] >> (idx % 64)) & 1) return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Finds the tiles overlapping rect, touching edges don't count
+     * @param rect test rect in pixels
+     * @returns false if rect misses the map, otherwise the inclusive range
+     * of tile coords clipped to the map
+     */
+    bool tile_range(const Rectangle &rect,
+                    int &left,
+                    int &top,
+                    int &right,
+                    int &bottom) const {
+        left = std::max<int>(std::floor(rect.x / tileWidth), 0);
+        top = std::max<int>(std::floor(rect.y / tileHeight), 0);
+        right = std::min<int>(std::ceil((rect.x + rect.width) / tileWidth) - 1,
+                              (int)width - 1);
+        bottom =
+            std::min<int>(std::ceil((rect.y + rect.height) / tileHeight) - 1,
+                          (int)height - 1);
+        return left <= right && top <= bottom;
+    }
+
+    /**
+     * Visits every non-empty tile on a visible layer overlapping rect,
+     * without allocating
+     * @param rect test rect in pixels
+     * @param visit called with (tmxparser::Tile &, unsigned int tile_idx),
+     * returns true to stop early
+     * @returns true if visit stopped early
+     */
+    template <typename F>
+    bool for_each_intersecting_tile(const Rectangle &rect, F &&visit) {
+        int left, top, right, bottom;
+        if (!tile_range(rect, left, top, right, bottom)) return false;
+        for (auto &layer : layerCollection) {
+            if (!layer.visible) continue;
+            // skip layers that don't reach the range
+            int layer_right = std::min<int>(right, (int)layer.width - 1);
+            int layer_bottom = std::min<int>(bottom, (int)layer.height - 1);
+
+            for (int y = top; y <= layer_bottom; ++y) {
+                for (int x = left; x <= layer_right; ++x) {
+                    // no flip since map orientation is correct in the tmx file
+                    unsigned int tile_pos = y * layer.width + x;
+                    tmxparser::Tile &tile = layer.tiles[tile_pos];
+                    if (tile.gid != 0 && visit(tile, tile_pos)) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+  private:
+    /**
+     * Merges the "blocked" tiles of every visible layer into the bitmap
+     */
+    void bake_blocked();
+
+    // one bit per tile, row major
+    std::vector<uint64_t> blocked;
 };
 
 #endif // HIDO_MAP_MAP_HPP
@@ -4,7 +4,198 @@
 #include <sys/socket.h>
 
 #include <cstring>
+#include <iterator>
 
-PacketHeader *get_header(Packet &packet) {
-    return (PacketHeader *)packet.data();
+const char *packet_type_name(PacketType type) {
+    constexpr const char *NAMES[] = {
+        "connect",
+        "disconnect",
+        "input",
+        "game_state",
+        "ping",
+    };
+    static_assert(std::size(NAMES) == PACKET_TYPE_COUNT);
+    return NAMES[(size_t)type];
+}
+
+void write_id(BitWriter &writer, int id) {
+    writer.write_bits(id + 1, ID_BITS);
+}
+
+int read_id(BitReader &reader) {
+    return (int)reader.read_bits(ID_BITS) - 1;
+}
+
+void write_position(BitWriter &writer, const Vector2 &pos) {
+    writer.write_quantized(pos.x, POSITION_QUANTIZATION);
+    writer.write_quantized(pos.y, POSITION_QUANTIZATION);
+}
+
+Vector2 read_position(BitReader &reader) {
+    Vector2 pos;
+    pos.x = reader.read_quantized(POSITION_QUANTIZATION);
+    pos.y = reader.read_quantized(POSITION_QUANTIZATION);
+    return pos;
+}
+
+void write_sequence(BitWriter &writer, uint32_t sequence) {
+    writer.write_bits(sequence, SEQUENCE_BITS);
+}
+
+uint32_t read_sequence(BitReader &reader, uint32_t reference) {
+    uint16_t low = reader.read_bits(SEQUENCE_BITS);
+    // wrapping distance from the reference, either way
+    int16_t delta = low - (uint16_t)reference;
+    return reference + delta;
+}
+
+void write_header(BitWriter &writer, const PacketHeader &header) {
+    writer.write_bits((uint32_t)header.type, 4);
+    write_id(writer, header.sender);
+}
+
+bool read_header(BitReader &reader, PacketHeader &header) {
+    header.type = (PacketType)reader.read_bits(4);
+    header.sender = read_id(reader);
+    return reader.ok() && header.type <= PacketType::PING;
+}
+
+bool peek_header(const Packet &packet, size_t len, PacketHeader &header) {
+    BitReader reader(packet.data(), len);
+    return read_header(reader, header);
+}
+
+void write_name(BitWriter &writer, const char name[MAX_NAME_LENGTH + 1]) {
+    uint32_t len = strnlen(name, MAX_NAME_LENGTH);
+    writer.write_bits(len, 4);
+    for (uint32_t i = 0; i < len; ++i) {
+        writer.write_bits((uint8_t)name[i], 8);
+    }
+}
+
+void read_name(BitReader &reader, char name[MAX_NAME_LENGTH + 1]) {
+    uint32_t len = std::min<uint32_t>(reader.read_bits(4), MAX_NAME_LENGTH);
+    for (uint32_t i = 0; i < len; ++i) {
+        name[i] = (char)reader.read_bits(8);
+    }
+    name[len] = '\0';
+}
+
+size_t serialize(const ClientPacket &p, Packet &packet) {
+    BitWriter writer(packet.data(), packet.size());
+    write_header(writer, p.header);
+    write_name(writer, p.name);
+    writer.write_bits(p.tick, 32);
+    return writer.bytes();
+}
+
+size_t serialize(const InputBatch &p, Packet &packet) {
+    BitWriter writer(packet.data(), packet.size());
+    write_header(writer, p.header);
+    // stays 0 until the first snapshot arrives, which no tick can stand for
+    // once it's cut down to its low bits
+    writer.write_bool(p.ack_snapshot != 0);
+    if (p.ack_snapshot != 0) write_sequence(writer, p.ack_snapshot);
+    writer.write_bits(p.count - 1, INPUT_COUNT_BITS);
+    // the rest follow on from the newest
+    write_sequence(writer, p.inputs[p.count - 1].sequence);
+
+    InputPacket prev;
+    for (size_t i = 0; i < p.count; ++i) {
+        const InputPacket &input = p.inputs[i];
+        writer.write_bool(input.left);
+        writer.write_bool(input.right);
+        writer.write_bool(input.up);
+        writer.write_bool(input.down);
+        writer.write_bool(input.mouse_down);
+        bool mouse_moved =
+            POSITION_QUANTIZATION.encode(input.mouse_pos.x) !=
+                POSITION_QUANTIZATION.encode(prev.mouse_pos.x) ||
+            POSITION_QUANTIZATION.encode(input.mouse_pos.y) !=
+                POSITION_QUANTIZATION.encode(prev.mouse_pos.y);
+        writer.write_bool(mouse_moved);
+        if (mouse_moved) write_position(writer, input.mouse_pos);
+        bool dt_changed =
+            DT_QUANTIZATION.encode(input.dt) != DT_QUANTIZATION.encode(prev.dt);
+        writer.write_bool(dt_changed);
+        if (dt_changed) writer.write_quantized(input.dt, DT_QUANTIZATION);
+        // lag compensation only needs to know what a shot was aimed at
+        if (input.mouse_down) {
+            writer.write_bool(input.view_tick != 0);
+            if (input.view_tick != 0) write_sequence(writer, input.view_tick);
+        }
+        prev = input;
+    }
+    return writer.bytes();
+}
+
+size_t serialize(const PingPacket &p, Packet &packet) {
+    BitWriter writer(packet.data(), packet.size());
+    write_header(writer, p.header);
+    writer.write_bits(p.client_time, 32);
+    writer.write_bits(p.server_time, 32);
+    return writer.bytes();
+}
+
+bool deserialize(const Packet &packet, size_t len, ClientPacket &p) {
+    BitReader reader(packet.data(), len);
+    read_header(reader, p.header);
+    read_name(reader, p.name);
+    p.tick = reader.read_bits(32);
+    return reader.ok();
+}
+
+bool deserialize(const Packet &packet,
+                 size_t len,
+                 InputBatch &p,
+                 uint32_t last_sequence,
+                 uint32_t tick) {
+    BitReader reader(packet.data(), len);
+    read_header(reader, p.header);
+    p.ack_snapshot = reader.read_bool() ? read_sequence(reader, tick) : 0;
+    p.count = reader.read_bits(INPUT_COUNT_BITS) + 1;
+    uint32_t newest = read_sequence(reader, last_sequence);
+
+    InputPacket prev;
+    for (size_t i = 0; i < p.count && reader.ok(); ++i) {
+        InputPacket &input = p.inputs[i];
+        input.sequence = newest - (p.count - 1 - i);
+        input.left = reader.read_bool();
+        input.right = reader.read_bool();
+        input.up = reader.read_bool();
+        input.down = reader.read_bool();
+        input.mouse_down = reader.read_bool();
+        input.mouse_pos =
+            reader.read_bool() ? read_position(reader) : prev.mouse_pos;
+        input.dt = reader.read_bool() ? reader.read_quantized(DT_QUANTIZATION)
+                                      : prev.dt;
+        input.view_tick = 0;
+        if (input.mouse_down && reader.read_bool()) {
+            input.view_tick = read_sequence(reader, tick);
+        }
+        prev = input;
+    }
+    return reader.ok();
+}
+
+bool deserialize(const Packet &packet, size_t len, PingPacket &p) {
+    BitReader reader(packet.data(), len);
+    read_header(reader, p.header);
+    p.client_time = reader.read_bits(32);
+    p.server_time = reader.read_bits(32);
+    return reader.ok();
+}
+
+uint64_t expand_millis(uint32_t low, uint64_t reference) {
+    const uint64_t wrap = 1ull << 32;
+    uint64_t t = (reference & ~(wrap - 1)) | low;
+    // pick whichever wrap of the low bits is closest to reference, the
+    // signed distance doesn't overflow near either end of the range
+    int64_t distance = t - reference;
+    if (distance > (int64_t)(wrap / 2) && t >= wrap) {
+        t -= wrap;
+    } else if (distance < -(int64_t)(wrap / 2) && t <= UINT64_MAX - wrap) {
+        t += wrap;
+    }
+    return t;
 }
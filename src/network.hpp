@@ -4,94 +4,191 @@
 #include <netinet/in.h>
 #include <raylib.h>
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
+#include "bitstream.hpp"
+#include "state/bullet.hpp"
 #include "state/player.hpp"
 
 constexpr uint32_t PORT = 8080;
 constexpr size_t ETHERNET_MTU = 1500;
-constexpr size_t MAX_PLAYERS = 5;
-// since packets take time to arrive
+// default player capacity, set per server at startup
+constexpr size_t DEFAULT_MAX_PLAYERS = 256;
+// how far behind the server clients render others until they've measured
+// their connection, see ClockSync
 constexpr uint64_t INTERPOLATION_DELAY = 100;
+// the server only keeps hitboxes about half a second back
+constexpr uint64_t MAX_INTERPOLATION_DELAY = 400;
 constexpr uint32_t FPS = 60;
 constexpr uint32_t TICK_INTERVAL = 1000 / FPS;
+// seconds simulated per tick
+constexpr float TICK_DT = TICK_INTERVAL / 1000.0f;
 
 enum class PacketType : uint8_t {
     CLIENT_CONNECT,
     CLIENT_DISCONNECT,
-    BULLET,
     INPUT,
     GAME_STATE,
+    // clock sync, the client sends it and the server echoes it back stamped
+    PING,
 };
+constexpr size_t PACKET_TYPE_COUNT = (size_t)PacketType::PING + 1;
+
+// lowercase name for logs and traces
+const char *packet_type_name(PacketType type);
 
 struct PacketHeader {
-    uint64_t timestamp = 0; // millis
     PacketType type;
     int sender = -1;
 };
 
-constexpr size_t MAX_PACKET_SIZE = ETHERNET_MTU - sizeof(PacketHeader);
-
 using Packet = std::array<int8_t, ETHERNET_MTU>;
 
+// WIRE FORMAT
+// packets are bit packed field by field, never memcpy'd, so the layout of
+// the structs below doesn't matter. Floats are quantized to these ranges.
+
+// maps must fit inside the quantized world
+constexpr float WORLD_MIN = -512.0f, WORLD_MAX = 3583.0f;
+constexpr Quantization POSITION_QUANTIZATION{
+    WORLD_MIN, WORLD_MAX, 1.0f / 16.0f};
+constexpr Quantization SIZE_QUANTIZATION{0.0f, 63.0f, 1.0f / 16.0f};
+constexpr Quantization HEALTH_QUANTIZATION{0.0f, 1.0f, 1.0f / 255.0f};
+constexpr Quantization DT_QUANTIZATION{0.0f, 0.25f, 1.0f / 8000.0f};
+constexpr Quantization VELOCITY_QUANTIZATION{-512.0f, 512.0f, 1.0f / 64.0f};
+// ticks a bullet can fly for, sent as 16 bits
+constexpr uint32_t MAX_FLIGHT_TICKS = 0xffff;
+
+// type, sender
+constexpr size_t PACKET_HEADER_BITS = 4 + 16;
+// ticks and input sequences count up in 32 bits on either side, but only
+// their low bits go over the wire and are expanded against the newest one
+// the receiver has seen, so the two can't drift half the range apart
+constexpr uint32_t SEQUENCE_BITS = 16;
+// ids go over the wire as 16 bits, shifted so -1 fits
+constexpr uint32_t ID_BITS = 16;
+constexpr uint32_t BULLET_ID_BITS = 32;
+// the low bits of an id are its slot on the server, so ids can index arrays
+// on either side with the generation masked off
+constexpr uint32_t CLIENT_SLOT_BITS = 10;
+constexpr size_t MAX_CLIENTS = 1 << CLIENT_SLOT_BITS;
+constexpr uint32_t BULLET_SLOT_BITS = 15;
+constexpr size_t MAX_BULLETS = 1 << BULLET_SLOT_BITS;
+
 // PROTOCOLS
 // disconnect: client disconnects, server broadcasts message
-// Game State: player states
-// BulletState: all the bullets
+// Game State: player states and the bullets in flight
 
 struct ClientPacket {
     PacketHeader header;
     char name[MAX_NAME_LENGTH + 1];
+    // server tick, sent in full when a connect is acknowledged so the
+    // client has something to expand sequences against
+    uint32_t tick = 0;
 };
 
+// one frame of a client's input, sent inside an InputBatch
 struct InputPacket {
-    PacketHeader header;
+    uint32_t sequence = 0; // counts up from 1 per client
     bool left = false, right = false, up = false, down = false,
          mouse_down = false;
     Vector2 mouse_pos{0.0f, 0.0f};
     float dt = 0.0f;
+    // server tick the client was rendering others at, 0 if none yet, only
+    // sent with shots
+    uint32_t view_tick = 0;
 };
 
-struct GameStatePacket {
+// inputs the server buffers per client, about a second at 60 fps. It skips
+// ahead over any older than that once newer ones arrive, so a client never
+// needs to keep more unacknowledged.
+constexpr size_t INPUT_QUEUE_SIZE = 64;
+// most inputs one datagram repeats, the count is sent minus one
+constexpr size_t MAX_INPUT_BATCH = 16;
+constexpr uint32_t INPUT_COUNT_BITS = 4;
+static_assert(MAX_INPUT_BATCH <= (1u << INPUT_COUNT_BITS));
+
+// a client's newest inputs, so each one survives the loss of the datagrams
+// before it. Each input is sent as the fields that changed since the one
+// before it.
+struct InputBatch {
     PacketHeader header;
-    int8_t num_players = 0;
-    int client_id = 0; // tells clients what their id is
-    std::array<PlayerState, MAX_PLAYERS> players;
+    // newest snapshot the client decoded, the server's delta baseline
+    uint32_t ack_snapshot = 0;
+    // consecutive sequences, oldest first
+    std::array<InputPacket, MAX_INPUT_BATCH> inputs;
+    size_t count = 0;
 };
 
-struct BulletPacket {
-    int sender = -1, id = -1;
-    Vector2 pos = {0.0f, 0.0f};
+// clocks on different machines only ever compare their low 32 bits
+struct PingPacket {
+    PacketHeader header;
+    uint32_t client_time = 0; // client millis when sent
+    uint32_t server_time = 0; // server millis when echoed
 };
-constexpr size_t MAX_BULLETS_PER_PACKET =
-    MAX_PACKET_SIZE / sizeof(BulletPacket);
 
-struct BulletStatePacket {
+// sent delta encoded and split across datagrams, see snapshot.hpp
+struct GameStatePacket {
     PacketHeader header;
-    int num_bullets = 0;
-    std::array<BulletPacket, MAX_BULLETS_PER_PACKET> bullets;
+    uint32_t sequence = 0; // the server tick, 0 is never sent
+    // server millis when sent, only the low 32 bits go over the wire
+    uint64_t timestamp = 0;
+    int client_id = 0;     // tells clients what their id is
+    uint32_t input_ack = 0; // newest input of this client the server applied
+    std::vector<PlayerState> players; // sorted by id
+    // never change once fired, so only spawns and despawns go over the wire
+    std::vector<BulletState> bullets; // sorted by id
 };
 
+void write_id(BitWriter &writer, int id);
+int read_id(BitReader &reader);
+void write_position(BitWriter &writer, const Vector2 &pos);
+Vector2 read_position(BitReader &reader);
+
+void write_sequence(BitWriter &writer, uint32_t sequence);
 /**
- * Create a packet from a packet type such as InputPacket
- * */
-template <typename T>
-Packet create_packet_from(const T &packet) {
-    Packet p;
-    auto dest = p.data();
-    memcpy(dest, &packet, sizeof(packet));
-    return p;
-}
+ * @param reference newest sequence the receiver has on the same counter
+ * @returns the sequence closest to reference with the low bits read
+ */
+uint32_t read_sequence(BitReader &reader, uint32_t reference);
 
-template <typename T>
-T *get_packet_data(Packet &packet) {
-    return (T *)packet.data();
-}
+void write_header(BitWriter &writer, const PacketHeader &header);
+bool read_header(BitReader &reader, PacketHeader &header);
 
-PacketHeader *get_header(Packet &packet);
+/**
+ * Reads just the header to find out what kind of packet this is
+ * @param packet received datagram
+ * @param len size of the received datagram
+ * @param header the decoded header
+ * @returns false if the packet is too short
+ */
+bool peek_header(const Packet &packet, size_t len, PacketHeader &header);
+
+void write_name(BitWriter &writer, const char name[MAX_NAME_LENGTH + 1]);
+void read_name(BitReader &reader, char name[MAX_NAME_LENGTH + 1]);
+
+// write a packet type into a datagram, returns the number of bytes to send
+size_t serialize(const ClientPacket &p, Packet &packet);
+size_t serialize(const InputBatch &p, Packet &packet);
+size_t serialize(const PingPacket &p, Packet &packet);
+
+// read a packet type from a datagram, returns false if it is malformed
+bool deserialize(const Packet &packet, size_t len, ClientPacket &p);
+/**
+ * @param last_sequence newest input sequence of the sender
+ * @param tick the server's current tick
+ */
+bool deserialize(const Packet &packet,
+                 size_t len,
+                 InputBatch &p,
+                 uint32_t last_sequence,
+                 uint32_t tick);
+bool deserialize(const Packet &packet, size_t len, PingPacket &p);
 
 inline uint64_t get_now_millis() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -99,8 +196,21 @@ inline uint64_t get_now_millis() {
         .count();
 }
 
-inline uint64_t get_render_time() {
-    return get_now_millis() - INTERPOLATION_DELAY;
+inline uint64_t get_now_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * Rebuilds a full timestamp from its low 32 bits
+ * @param low the truncated timestamp
+ * @param reference full timestamp on the same clock as low
+ * @returns the timestamp closest to reference with those low bits
+ */
+uint64_t expand_millis(uint32_t low, uint64_t reference);
+inline uint64_t expand_millis(uint32_t low) {
+    return expand_millis(low, get_now_millis());
 }
 
 #endif // HIDO_NETWORK_HPP
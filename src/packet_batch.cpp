@@ -0,0 +1,94 @@
+#include "packet_batch.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cerrno>
+#include <cstring>
+
+RecvBatch::RecvBatch() {
+    for (size_t i = 0; i < PACKET_BATCH_SIZE; ++i) {
+        iovecs[i].iov_base = packets[i].data();
+        iovecs[i].iov_len = packets[i].size();
+        msgs[i].msg_hdr = {};
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_len = 0;
+    }
+}
+
+int RecvBatch::receive(int sock) {
+    // the kernel overwrites the name length with the actual address size
+    for (auto &msg : msgs) {
+        msg.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+    int n = recvmmsg(sock, msgs.data(), msgs.size(), MSG_DONTWAIT, nullptr);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            spdlog::error("recvmmsg failed: {}", strerror(errno));
+        }
+        return 0;
+    }
+    return n;
+}
+
+SendBatch::SendBatch() {
+    for (size_t i = 0; i < PACKET_BATCH_SIZE; ++i) {
+        iovecs[i].iov_base = packets[i].data();
+        msgs[i].msg_hdr = {};
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+}
+
+void SendBatch::push(int sock,
+                     const void *data,
+                     size_t len,
+                     const sockaddr_in &addr) {
+    if (count == PACKET_BATCH_SIZE) {
+        flush(sock);
+    }
+    memcpy(packets[count].data(), data, len);
+    iovecs[count].iov_len = len;
+    addrs[count] = addr;
+    count++;
+}
+
+void SendBatch::flush(int sock) {
+    // replays have no socket, what they'd send is dropped
+    if (sock < 0) {
+        count = 0;
+        return;
+    }
+    size_t sent = 0;
+    while (sent < count) {
+        int n = sendmmsg(sock, msgs.data() + sent, count - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // socket buffer full, UDP is lossy anyways
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                spdlog::error("sendmmsg failed: {}", strerror(errno));
+            }
+            break;
+        }
+        sent += n;
+    }
+    if (sent < count) {
+        if (drop_handler) {
+            for (size_t i = sent; i < count; ++i) {
+                drop_handler(packets[i], iovecs[i].iov_len);
+            }
+        }
+        dropped += count - sent;
+        uint64_t now = get_now_millis();
+        if (now - last_warning >= 1000) {
+            spdlog::warn("Socket buffer full, dropped {} datagrams.",
+                         dropped);
+            dropped = 0;
+            last_warning = now;
+        }
+    }
+    count = 0;
+}
@@ -0,0 +1,98 @@
+#ifndef HIDO_PACKETBATCH_HPP
+#define HIDO_PACKETBATCH_HPP
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "network.hpp"
+
+// datagrams moved per recvmmsg/sendmmsg call
+constexpr size_t PACKET_BATCH_SIZE = 64;
+
+/**
+ * Pre-allocated buffers for draining a non-blocking UDP socket with recvmmsg
+ */
+class RecvBatch {
+  public:
+    RecvBatch();
+
+    /**
+     * Reads up to PACKET_BATCH_SIZE datagrams without blocking
+     * @param sock socket to read from
+     * @returns number of datagrams received, 0 when the socket is empty
+     */
+    int receive(int sock);
+
+    Packet &packet(size_t idx) {
+        return packets[idx];
+    }
+    const sockaddr_in &addr(size_t idx) const {
+        return addrs[idx];
+    }
+    size_t length(size_t idx) const {
+        return msgs[idx].msg_len;
+    }
+
+  private:
+    std::array<Packet, PACKET_BATCH_SIZE> packets;
+    std::array<sockaddr_in, PACKET_BATCH_SIZE> addrs;
+    std::array<iovec, PACKET_BATCH_SIZE> iovecs;
+    std::array<mmsghdr, PACKET_BATCH_SIZE> msgs;
+};
+
+/**
+ * Queues outgoing datagrams and sends them with as few sendmmsg calls as
+ * possible
+ */
+class SendBatch {
+  public:
+    SendBatch();
+
+    /**
+     * Copies a datagram into the queue, flushing first if the queue is full
+     * @param sock socket used if an early flush is needed
+     * @param data bytes of the datagram
+     * @param len size of the datagram, at most ETHERNET_MTU
+     * @param addr destination
+     */
+    void push(int sock, const void *data, size_t len, const sockaddr_in &addr);
+
+    /**
+     * Sends every queued datagram, drops the remainder if the socket buffer
+     * is full
+     * @param sock socket to send on, everything is dropped if it's negative
+     */
+    void flush(int sock);
+
+    /**
+     * @param handler called with each datagram the socket buffer had no
+     * room for, so whoever counted it as sent can take it back
+     */
+    void on_drop(std::function<void(const Packet &, size_t)> handler) {
+        drop_handler = std::move(handler);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+  private:
+    std::array<Packet, PACKET_BATCH_SIZE> packets;
+    std::array<sockaddr_in, PACKET_BATCH_SIZE> addrs;
+    std::array<iovec, PACKET_BATCH_SIZE> iovecs;
+    std::array<mmsghdr, PACKET_BATCH_SIZE> msgs;
+    size_t count = 0;
+
+    std::function<void(const Packet &, size_t)> drop_handler;
+    // dropped since the last warning, logged at most once a second
+    uint64_t dropped = 0;
+    uint64_t last_warning = 0;
+};
+
+#endif // HIDO_PACKETBATCH_HPP
@@ -0,0 +1,99 @@
+#include "bullet_pool.hpp"
+
+BulletPool::BulletPool() : slots(MAX_BULLETS) {
+    auto reserve = [](auto &...columns) {
+        (columns.reserve(MAX_BULLETS), ...);
+    };
+    reserve(ids, senders, origin_x, origin_y, vel_x, vel_y);
+    reserve(spawn_ticks, impact_ticks, rewind_ticks, x, y, expired_flags);
+    // lowest slots are handed out first
+    free_slots.reserve(MAX_BULLETS);
+    for (uint32_t slot = MAX_BULLETS; slot > 0; --slot) {
+        free_slots.push_back(slot - 1);
+    }
+}
+
+int BulletPool::spawn(const BulletState &bullet) {
+    if (free_slots.empty()) return -1;
+    uint32_t slot = free_slots.back();
+    free_slots.pop_back();
+
+    int id = slots[slot].generation << BULLET_SLOT_BITS | slot;
+    slots[slot].dense = ids.size();
+    ids.push_back(id);
+    senders.push_back(bullet.sender);
+    origin_x.push_back(bullet.origin.x);
+    origin_y.push_back(bullet.origin.y);
+    vel_x.push_back(bullet.vel.x);
+    vel_y.push_back(bullet.vel.y);
+    spawn_ticks.push_back(bullet.spawn_tick);
+    impact_ticks.push_back(bullet.impact_tick);
+    rewind_ticks.push_back(bullet.rewind_ticks);
+    // placed by the next advance()
+    x.push_back(bullet.origin.x);
+    y.push_back(bullet.origin.y);
+    expired_flags.push_back(0);
+    return id;
+}
+
+void BulletPool::advance(uint32_t tick) {
+    advance_bullets({origin_x.data(),
+                     origin_y.data(),
+                     vel_x.data(),
+                     vel_y.data(),
+                     spawn_ticks.data(),
+                     impact_ticks.data(),
+                     x.data(),
+                     y.data(),
+                     expired_flags.data(),
+                     ids.size()},
+                    tick);
+}
+
+void BulletPool::remove_at(uint32_t dense) {
+    uint32_t slot = ids[dense] & (MAX_BULLETS - 1);
+    // swap with the last bullet to keep the arrays dense
+    auto swap_pop = [dense](auto &...columns) {
+        ((columns[dense] = columns.back(), columns.pop_back()), ...);
+    };
+    swap_pop(ids, senders, origin_x, origin_y, vel_x, vel_y);
+    swap_pop(spawn_ticks, impact_ticks, rewind_ticks, x, y, expired_flags);
+    if (dense < ids.size()) {
+        slots[ids[dense] & (MAX_BULLETS - 1)].dense = dense;
+    }
+
+    // retire the id, the next bullet in this slot gets a new one
+    slots[slot].dense = NO_BULLET;
+    slots[slot].generation =
+        (slots[slot].generation + 1) % (1 << BULLET_GENERATION_BITS);
+    free_slots.push_back(slot);
+}
+
+int BulletPool::find_by_id(int id) const {
+    uint32_t slot = id & (MAX_BULLETS - 1);
+    uint32_t generation = (uint32_t)id >> BULLET_SLOT_BITS;
+    if (id < 0 || slots[slot].dense == NO_BULLET ||
+        slots[slot].generation != generation) {
+        return -1;
+    }
+    return slots[slot].dense;
+}
+
+BulletState BulletPool::get(size_t i) const {
+    BulletState bullet;
+    bullet.id = ids[i];
+    bullet.sender = senders[i];
+    bullet.origin = {origin_x[i], origin_y[i]};
+    bullet.vel = {vel_x[i], vel_y[i]};
+    bullet.spawn_tick = spawn_ticks[i];
+    bullet.impact_tick = impact_ticks[i];
+    bullet.rewind_ticks = rewind_ticks[i];
+    return bullet;
+}
+
+void BulletPool::get_bullets(std::vector<BulletState> &out) const {
+    out.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        out[i] = get(i);
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef HIDO_SERVER_BULLETPOOL_HPP
+#define HIDO_SERVER_BULLETPOOL_HPP
+
+#include <raylib.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "network.hpp"
+#include "server/bullet_simd.hpp"
+#include "state/bullet.hpp"
+
+// ids are a slot index tagged with the slot's generation like client ids,
+// so a client never mistakes a new bullet for one it already knows
+// leaves the sign bit free
+constexpr uint32_t BULLET_GENERATION_BITS =
+    BULLET_ID_BITS - BULLET_SLOT_BITS - 1;
+
+/**
+ * Fixed capacity store of the bullets in flight. Each field is its own
+ * dense array so a tick streams through them with SIMD, with O(1) lookup
+ * by id. Memory is allocated once up front. Indices are invalidated by
+ * remove_if().
+ */
+class BulletPool {
+  public:
+    BulletPool();
+
+    /**
+     * Adds a bullet under a fresh id
+     * @returns the id, -1 if the pool is full
+     */
+    int spawn(const BulletState &bullet);
+
+    /**
+     * Moves every bullet to where it is at tick, see advance_bullets
+     */
+    void advance(uint32_t tick);
+
+    /**
+     * Despawns every bullet pred returns true for
+     * @param pred called with the bullet's index
+     */
+    template <typename F>
+    void remove_if(F &&pred) {
+        for (size_t i = 0; i < ids.size();) {
+            if (pred(i)) {
+                remove_at(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    /**
+     * @returns index of the bullet or -1 if the id is unknown or stale
+     */
+    int find_by_id(int id) const;
+    size_t count() const {
+        return ids.size();
+    }
+
+    // fields by index, positions and expiry are as of the last advance()
+    int sender(size_t i) const {
+        return senders[i];
+    }
+    uint32_t rewind(size_t i) const {
+        return rewind_ticks[i];
+    }
+    bool expired(size_t i) const {
+        return expired_flags[i] != 0;
+    }
+    Rectangle rect(size_t i) const {
+        return {x[i], y[i], BULLET_SIZE, BULLET_SIZE};
+    }
+    BulletState get(size_t i) const;
+
+    /**
+     * @param out replaced with every bullet, in no particular order
+     */
+    void get_bullets(std::vector<BulletState> &out) const;
+
+  private:
+    void remove_at(uint32_t dense);
+
+    struct Slot {
+        // index into the arrays, NO_BULLET when the slot is free
+        uint32_t dense = NO_BULLET;
+        uint32_t generation = 0;
+    };
+    constexpr static uint32_t NO_BULLET = UINT32_MAX;
+
+    std::vector<int> ids, senders;
+    std::vector<float> origin_x, origin_y, vel_x, vel_y;
+    std::vector<uint32_t> spawn_ticks, impact_ticks, rewind_ticks;
+    // filled in by advance()
+    std::vector<float> x, y;
+    std::vector<uint32_t> expired_flags;
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+};
+
+#endif // HIDO_SERVER_BULLETPOOL_HPP
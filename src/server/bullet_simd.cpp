@@ -0,0 +1,175 @@
+#include "bullet_simd.hpp"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "network.hpp"
+
+namespace {
+
+// same test as CheckCollisionRecs
+size_t first_overlap_scalar(const Rectangle &rect,
+                            const float *x,
+                            const float *y,
+                            const float *width,
+                            const float *height,
+                            size_t begin,
+                            size_t n) {
+    for (size_t i = begin; i < n; ++i) {
+        if (rect.x < x[i] + width[i] && rect.x + rect.width > x[i] &&
+            rect.y < y[i] + height[i] && rect.y + rect.height > y[i]) {
+            return i;
+        }
+    }
+    return n;
+}
+
+} // namespace
+
+void advance_bullets_scalar(const BulletColumns &b,
+                            uint32_t tick,
+                            size_t begin) {
+    for (size_t i = begin; i < b.count; ++i) {
+        // ages are small, the signed difference converts exactly
+        float t = (float)(int32_t)(tick - b.spawn_tick[i]) * TICK_DT;
+        b.x[i] = b.origin_x[i] + b.vel_x[i] * t;
+        b.y[i] = b.origin_y[i] + b.vel_y[i] * t;
+        b.expired[i] = (int32_t)(tick - b.impact_tick[i]) >= 0 ? ~0u : 0;
+    }
+}
+
+#if defined(__AVX2__)
+
+void advance_bullets(const BulletColumns &b, uint32_t tick) {
+    const __m256 dt = _mm256_set1_ps(TICK_DT);
+    const __m256i now = _mm256_set1_epi32(tick);
+    const __m256i minus_one = _mm256_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + 8 <= b.count; i += 8) {
+        __m256i spawn =
+            _mm256_loadu_si256((const __m256i *)(b.spawn_tick + i));
+        __m256 t = _mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_sub_epi32(now, spawn)), dt);
+        // multiply then add, no fma so lanes round like the scalar path
+        __m256 dx = _mm256_mul_ps(_mm256_loadu_ps(b.vel_x + i), t);
+        __m256 dy = _mm256_mul_ps(_mm256_loadu_ps(b.vel_y + i), t);
+        __m256 x = _mm256_add_ps(_mm256_loadu_ps(b.origin_x + i), dx);
+        __m256 y = _mm256_add_ps(_mm256_loadu_ps(b.origin_y + i), dy);
+        _mm256_storeu_ps(b.x + i, x);
+        _mm256_storeu_ps(b.y + i, y);
+        // now - impact >= 0 is now - impact > -1
+        __m256i impact =
+            _mm256_loadu_si256((const __m256i *)(b.impact_tick + i));
+        __m256i expired =
+            _mm256_cmpgt_epi32(_mm256_sub_epi32(now, impact), minus_one);
+        _mm256_storeu_si256((__m256i *)(b.expired + i), expired);
+    }
+    advance_bullets_scalar(b, tick, i);
+}
+
+size_t first_overlap(const Rectangle &rect,
+                     const float *x,
+                     const float *y,
+                     const float *width,
+                     const float *height,
+                     size_t n) {
+    const __m256 left = _mm256_set1_ps(rect.x);
+    const __m256 right = _mm256_set1_ps(rect.x + rect.width);
+    const __m256 top = _mm256_set1_ps(rect.y);
+    const __m256 bottom = _mm256_set1_ps(rect.y + rect.height);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 bx = _mm256_loadu_ps(x + i), by = _mm256_loadu_ps(y + i);
+        __m256 bx_end = _mm256_add_ps(bx, _mm256_loadu_ps(width + i));
+        __m256 by_end = _mm256_add_ps(by, _mm256_loadu_ps(height + i));
+        __m256 overlap =
+            _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(left, bx_end, _CMP_LT_OQ),
+                                        _mm256_cmp_ps(right, bx, _CMP_GT_OQ)),
+                          _mm256_and_ps(_mm256_cmp_ps(top, by_end, _CMP_LT_OQ),
+                                        _mm256_cmp_ps(bottom, by, _CMP_GT_OQ)));
+        int mask = _mm256_movemask_ps(overlap);
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    return first_overlap_scalar(rect, x, y, width, height, i, n);
+}
+
+const char *bullet_simd_name() {
+    return "avx2";
+}
+
+#elif defined(__SSE2__)
+
+void advance_bullets(const BulletColumns &b, uint32_t tick) {
+    const __m128 dt = _mm_set1_ps(TICK_DT);
+    const __m128i now = _mm_set1_epi32(tick);
+    const __m128i minus_one = _mm_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + 4 <= b.count; i += 4) {
+        __m128i spawn = _mm_loadu_si128((const __m128i *)(b.spawn_tick + i));
+        __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(now, spawn)), dt);
+        __m128 x = _mm_add_ps(_mm_loadu_ps(b.origin_x + i),
+                              _mm_mul_ps(_mm_loadu_ps(b.vel_x + i), t));
+        __m128 y = _mm_add_ps(_mm_loadu_ps(b.origin_y + i),
+                              _mm_mul_ps(_mm_loadu_ps(b.vel_y + i), t));
+        _mm_storeu_ps(b.x + i, x);
+        _mm_storeu_ps(b.y + i, y);
+        // now - impact >= 0 is now - impact > -1
+        __m128i impact = _mm_loadu_si128((const __m128i *)(b.impact_tick + i));
+        __m128i expired =
+            _mm_cmpgt_epi32(_mm_sub_epi32(now, impact), minus_one);
+        _mm_storeu_si128((__m128i *)(b.expired + i), expired);
+    }
+    advance_bullets_scalar(b, tick, i);
+}
+
+size_t first_overlap(const Rectangle &rect,
+                     const float *x,
+                     const float *y,
+                     const float *width,
+                     const float *height,
+                     size_t n) {
+    const __m128 left = _mm_set1_ps(rect.x);
+    const __m128 right = _mm_set1_ps(rect.x + rect.width);
+    const __m128 top = _mm_set1_ps(rect.y);
+    const __m128 bottom = _mm_set1_ps(rect.y + rect.height);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 bx = _mm_loadu_ps(x + i), by = _mm_loadu_ps(y + i);
+        __m128 overlap = _mm_and_ps(
+            _mm_and_ps(
+                _mm_cmplt_ps(left, _mm_add_ps(bx, _mm_loadu_ps(width + i))),
+                _mm_cmpgt_ps(right, bx)),
+            _mm_and_ps(
+                _mm_cmplt_ps(top, _mm_add_ps(by, _mm_loadu_ps(height + i))),
+                _mm_cmpgt_ps(bottom, by)));
+        int mask = _mm_movemask_ps(overlap);
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    return first_overlap_scalar(rect, x, y, width, height, i, n);
+}
+
+const char *bullet_simd_name() {
+    return "sse2";
+}
+
+#else
+
+void advance_bullets(const BulletColumns &b, uint32_t tick) {
+    advance_bullets_scalar(b, tick);
+}
+
+size_t first_overlap(const Rectangle &rect,
+                     const float *x,
+                     const float *y,
+                     const float *width,
+                     const float *height,
+                     size_t n) {
+    return first_overlap_scalar(rect, x, y, width, height, 0, n);
+}
+
+const char *bullet_simd_name() {
+    return "scalar";
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef HIDO_SERVER_BULLETSIMD_HPP
+#define HIDO_SERVER_BULLETSIMD_HPP
+
+#include <raylib.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Columns of a structure of arrays bullet store, see BulletPool
+ */
+struct BulletColumns {
+    const float *origin_x, *origin_y, *vel_x, *vel_y;
+    const uint32_t *spawn_tick, *impact_tick;
+    // written by advance_bullets
+    float *x, *y;
+    // nonzero once the bullet reached its impact tick
+    uint32_t *expired;
+    size_t count;
+};
+
+/**
+ * Places every bullet where it is at tick and flags expired ones. Uses AVX2
+ * or SSE2 when built for them, the lanes do exactly what the scalar path
+ * does so results don't depend on the build.
+ */
+void advance_bullets(const BulletColumns &b, uint32_t tick);
+
+/**
+ * Scalar advance_bullets from bullet begin on
+ */
+void advance_bullets_scalar(const BulletColumns &b,
+                            uint32_t tick,
+                            size_t begin = 0);
+
+/**
+ * Tests one rect against n boxes given as parallel arrays, several at a
+ * time
+ * @returns index of the first box overlapping rect, n if none do
+ */
+size_t first_overlap(const Rectangle &rect,
+                     const float *x,
+                     const float *y,
+                     const float *width,
+                     const float *height,
+                     size_t n);
+
+/**
+ * @returns the instruction set the kernels were built for
+ */
+const char *bullet_simd_name();
+
+#endif // HIDO_SERVER_BULLETSIMD_HPP
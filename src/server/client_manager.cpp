@@ -3,7 +3,6 @@
 #include <netinet/in.h>
 #include <spdlog/spdlog.h>
 
-#include <algorithm>
 #include <cstring>
 
 #include "state/player.hpp"
@@ -19,50 +18,80 @@ ClientManager::ClientManager() {}
 
 ClientAddr *ClientManager::add(sockaddr_in client,
                                const char name[MAX_NAME_LENGTH + 1]) {
+    // return client if already contained
+    ClientAddr *existing = get(client);
+    if (existing != nullptr) {
+        return existing;
+    }
+
+    // reuse a freed slot before growing
+    uint32_t slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    } else if (slots.size() < MAX_CLIENTS) {
+        slot = slots.size();
+        slots.emplace_back();
+    } else {
+        return nullptr;
+    }
+
     ClientAddr new_client(client, name);
     // set starting position
     new_client.player.rect = {20.0f, 20.0f, PLAYER_WIDTH, PLAYER_HEIGHT};
-    auto itr = std::find_if(
-        clients.begin(), clients.end(), [&new_client](const auto &kv) {
-            return kv.second == new_client;
-        });
-    // add client if not already contained
-    if (itr == clients.end()) {
-        new_client.id = idx++;
-        spdlog::info("Client id: {}, name: {} connected.", new_client.id, name);
-        auto [itr, _] = clients.emplace(new_client.id, std::move(new_client));
-        return &itr->second;
-    }
-    return &itr->second;
+    new_client.id = slots[slot].generation << CLIENT_SLOT_BITS | slot;
+    new_client.player.id = new_client.id;
+    spdlog::info("Client id: {}, name: {} connected.", new_client.id, name);
+
+    slots[slot].dense = clients.size();
+    addr_index.emplace(addr_key(client), new_client.id);
+    clients.push_back(std::move(new_client));
+    return &clients.back();
 }
 
 ClientAddr *ClientManager::get(sockaddr_in client) {
-    ClientAddr new_client(client);
-    // set starting position
-    new_client.player.rect = {20.0f, 20.0f, PLAYER_WIDTH, PLAYER_HEIGHT};
-    auto itr = std::find_if(
-        clients.begin(), clients.end(), [&new_client](const auto &kv) {
-            return kv.second == new_client;
-        });
+    auto itr = addr_index.find(addr_key(client));
     // if client doesn't exist uh oh
-    if (itr == clients.end()) {
+    if (itr == addr_index.end()) {
         return nullptr;
     }
-    return &itr->second;
+    return find_by_id(itr->second);
 }
 
 void ClientManager::remove(const ClientAddr &c) {
-    auto itr = clients.find(c.id);
-    if (itr != clients.end()) {
-        clients.erase(itr);
-        spdlog::info("Client {} disconnected.", c.id);
+    ClientID id = c.id;
+    ClientAddr *client = find_by_id(id);
+    if (client == nullptr) {
+        return;
+    }
+    Slot &slot = slots[id & (MAX_CLIENTS - 1)];
+    addr_index.erase(addr_key(client->addr));
+
+    // swap with the last client to keep the array dense
+    uint32_t dense = slot.dense;
+    if (dense != clients.size() - 1) {
+        clients[dense] = std::move(clients.back());
+        slots[clients[dense].id & (MAX_CLIENTS - 1)].dense = dense;
     }
+    clients.pop_back();
+
+    // retire the id, the next client in this slot gets a new one
+    slot.dense = NO_CLIENT;
+    slot.generation = (slot.generation + 1) % (1 << CLIENT_GENERATION_BITS);
+    free_slots.push_back(id & (MAX_CLIENTS - 1));
+    spdlog::info("Client {} disconnected.", id);
 }
 
 size_t ClientManager::count() const {
     return clients.size();
 }
 
-ClientAddr &ClientManager::find_by_id(ClientID id) {
-    return clients[id];
+ClientAddr *ClientManager::find_by_id(ClientID id) {
+    uint32_t slot = id & (MAX_CLIENTS - 1);
+    uint32_t generation = (uint32_t)id >> CLIENT_SLOT_BITS;
+    if (id < 0 || slot >= slots.size() || slots[slot].dense == NO_CLIENT ||
+        slots[slot].generation != generation) {
+        return nullptr;
+    }
+    return &clients[slots[slot].dense];
 }
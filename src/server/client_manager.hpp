@@ -3,13 +3,21 @@
 
 #include <netinet/in.h>
 
+#include <cstdint>
 #include <cstring>
 #include <unordered_map>
+#include <vector>
 
 #include "network.hpp"
+#include "server/input_queue.hpp"
 #include "state/player.hpp"
 
+// ids are a slot index tagged with the slot's generation, so a reused slot
+// never hands out an id a client may still remember
 using ClientID = int;
+// leaves the top id bit free, ids have to fit in ID_BITS with -1 shifted in
+constexpr uint32_t CLIENT_GENERATION_BITS = ID_BITS - CLIENT_SLOT_BITS - 1;
+
 struct ClientAddr {
     explicit ClientAddr(sockaddr_in addr);
     ClientAddr(sockaddr_in addr, const char name[MAX_NAME_LENGTH + 1]);
@@ -30,28 +38,60 @@ struct ClientAddr {
     }
     sockaddr_in addr;
     PlayerState player;
+    // inputs waiting for the next tick
+    InputQueue inputs;
+    // most recently applied input
     InputPacket last_input;
+    // seconds of movement the client's inputs may still take up, grows by a
+    // tick each tick up to MAX_INPUT_BUDGET
+    float input_budget = 0.0f;
+    // newest snapshot this client has, 0 means send a full snapshot
+    uint32_t ack_snapshot = 0;
     // optional, just used for storing id's by server
     ClientID id;
 };
 
+/**
+ * Stores clients densely for iteration, with O(1) lookup by address or id.
+ * Pointers returned are invalidated by add() and remove().
+ */
 class ClientManager {
   public:
     ClientManager();
+    /**
+     * @returns the new or existing client, nullptr if every slot is taken
+     */
     ClientAddr *add(sockaddr_in client, const char name[MAX_NAME_LENGTH + 1]);
     ClientAddr *get(sockaddr_in client);
     void remove(const ClientAddr &c);
     size_t count() const;
 
-    std::unordered_map<ClientID, ClientAddr> &get_clients() {
+    // contiguous, in no particular order
+    std::vector<ClientAddr> &get_clients() {
         return clients;
     }
 
-    ClientAddr &find_by_id(ClientID id);
+    /**
+     * @returns the client or nullptr if the id is unknown or stale
+     */
+    ClientAddr *find_by_id(ClientID id);
 
   private:
-    std::unordered_map<ClientID, ClientAddr> clients;
-    ClientID idx = 0;
+    static uint64_t addr_key(const sockaddr_in &addr) {
+        return (uint64_t)addr.sin_addr.s_addr << 16 | addr.sin_port;
+    }
+
+    struct Slot {
+        // index into clients, NO_CLIENT when the slot is free
+        uint32_t dense = NO_CLIENT;
+        uint32_t generation = 0;
+    };
+    constexpr static uint32_t NO_CLIENT = UINT32_MAX;
+
+    std::vector<ClientAddr> clients;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    std::unordered_map<uint64_t, ClientID> addr_index;
 };
 
 #endif // HIDO_SERVER_CLIENTMANAGER_HPP
@@ -0,0 +1,85 @@
+#include "hitbox_history.hpp"
+
+#include <algorithm>
+
+#include "server/bullet_simd.hpp"
+
+void HitboxFrame::clear() {
+    ids.clear();
+    x.clear();
+    y.clear();
+    width.clear();
+    height.clear();
+}
+
+void HitboxFrame::push(int id, const Rectangle &rect) {
+    ids.push_back(id);
+    x.push_back(rect.x);
+    y.push_back(rect.y);
+    width.push_back(rect.width);
+    height.push_back(rect.height);
+}
+
+void HitboxFrame::build_grid() {
+    grid.build(x.data(), y.data(), width.data(), height.data(), ids.size());
+    const std::vector<uint32_t> &items = grid.get_items();
+    cell_ids.resize(items.size());
+    cell_x.resize(items.size());
+    cell_y.resize(items.size());
+    cell_width.resize(items.size());
+    cell_height.resize(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        cell_ids[i] = ids[items[i]];
+        cell_x[i] = x[items[i]];
+        cell_y[i] = y[items[i]];
+        cell_width[i] = width[items[i]];
+        cell_height[i] = height[items[i]];
+    }
+}
+
+int HitboxFrame::hit_test(const Rectangle &rect, int ignore_id) const {
+    int hit = -1;
+    grid.query_ranges(rect, [&](uint32_t begin, uint32_t end) {
+        while (begin < end) {
+            begin += first_overlap(rect,
+                                   cell_x.data() + begin,
+                                   cell_y.data() + begin,
+                                   cell_width.data() + begin,
+                                   cell_height.data() + begin,
+                                   end - begin);
+            if (begin == end) return false;
+            if (cell_ids[begin] != ignore_id) {
+                hit = cell_ids[begin];
+                return true;
+            }
+            ++begin;
+        }
+        return false;
+    });
+    return hit;
+}
+
+void HitboxHistory::configure(float cell_width,
+                              float cell_height,
+                              uint32_t cols,
+                              uint32_t rows) {
+    for (HitboxFrame &frame : frames) {
+        frame.grid.configure(cell_width, cell_height, cols, rows);
+    }
+}
+
+HitboxFrame &HitboxHistory::record(uint64_t tick) {
+    HitboxFrame &frame = frames[tick % HITBOX_HISTORY];
+    frame.clear();
+    frame.tick = tick;
+    return frame;
+}
+
+const HitboxFrame &HitboxHistory::rewind(uint64_t tick,
+                                         uint32_t rewind_ticks) const {
+    uint64_t back = std::min<uint64_t>(
+        {rewind_ticks, HITBOX_HISTORY - 1, tick});
+    const HitboxFrame &frame = frames[(tick - back) % HITBOX_HISTORY];
+    if (frame.tick == tick - back) return frame;
+    return frames[tick % HITBOX_HISTORY];
+}
@@ -0,0 +1,83 @@
+#ifndef HIDO_SERVER_HITBOXHISTORY_HPP
+#define HIDO_SERVER_HITBOXHISTORY_HPP
+
+#include <raylib.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "network.hpp"
+#include "spatial_grid.hpp"
+
+// ticks of player hitboxes kept for rewinding, about half a second
+constexpr size_t HITBOX_HISTORY = 32;
+
+/**
+ * Every player's hitbox for one tick, stored as parallel arrays so a hit
+ * test is a tight loop over floats, with a grid so it only looks at nearby
+ * players
+ */
+struct HitboxFrame {
+    uint64_t tick = 0;
+    std::vector<int> ids;
+    std::vector<float> x, y, width, height;
+    SpatialGrid grid;
+    // the hitboxes copied out in grid order, so each cell is a contiguous
+    // run that's tested several boxes at a time
+    std::vector<int> cell_ids;
+    std::vector<float> cell_x, cell_y, cell_width, cell_height;
+
+    void clear();
+    void push(int id, const Rectangle &rect);
+    /**
+     * Indexes the pushed hitboxes, call once all of them are in
+     */
+    void build_grid();
+    size_t size() const {
+        return ids.size();
+    }
+
+    /**
+     * @param rect the rect to test, e.g. a bullet
+     * @param ignore_id id that can't be hit, e.g. the shooter
+     * @returns id of the first hitbox overlapping rect or -1
+     */
+    int hit_test(const Rectangle &rect, int ignore_id) const;
+};
+
+/**
+ * Ring of the last HITBOX_HISTORY ticks of player hitboxes, used to check
+ * hits against where the shooter saw everyone
+ */
+class HitboxHistory {
+  public:
+    /**
+     * Sets the grid every frame is indexed with, see SpatialGrid::configure
+     */
+    void configure(float cell_width,
+                   float cell_height,
+                   uint32_t cols,
+                   uint32_t rows);
+
+    /**
+     * Starts recording a tick, replacing the oldest frame
+     * @returns the empty frame to push hitboxes into, call build_grid on it
+     * when done
+     */
+    HitboxFrame &record(uint64_t tick);
+
+    /**
+     * @param tick the current tick
+     * @param rewind_ticks how far back to look, clamped to the history
+     * @returns the frame rewind_ticks before tick, or the newest one if that
+     * tick was never recorded
+     */
+    const HitboxFrame &rewind(uint64_t tick, uint32_t rewind_ticks) const;
+
+  private:
+    std::array<HitboxFrame, HITBOX_HISTORY> frames;
+};
+
+#endif // HIDO_SERVER_HITBOXHISTORY_HPP
@@ -0,0 +1,36 @@
+#include "input_queue.hpp"
+
+bool InputQueue::push(const InputPacket &input) {
+    uint32_t sequence = input.sequence;
+    if (sequence == 0) return false;
+    // start from whatever arrives first
+    if (next == 0) next = sequence;
+    if (sequence < next || has(sequence)) return false;
+    // everything before the window of this one was lost upstream, give up
+    // on it rather than on every input from now on
+    if (sequence >= next + INPUT_QUEUE_SIZE) {
+        next = sequence - INPUT_QUEUE_SIZE + 1;
+        stalled_ticks = 0;
+    }
+    inputs[sequence % INPUT_QUEUE_SIZE] = input;
+    if (sequence > newest) newest = sequence;
+    return true;
+}
+
+const InputPacket *InputQueue::pop() {
+    if (next == 0 || !has(next)) return nullptr;
+    stalled_ticks = 0;
+    return &inputs[next++ % INPUT_QUEUE_SIZE];
+}
+
+void InputQueue::end_tick() {
+    // nothing newer arrived, the client is just idle or behind
+    if (next == 0 || newest < next) {
+        stalled_ticks = 0;
+        return;
+    }
+    // a lost input holds up everything behind it, wait a little first
+    if (++stalled_ticks < INPUT_JITTER_TICKS) return;
+    while (next <= newest && !has(next)) next++;
+    stalled_ticks = 0;
+}
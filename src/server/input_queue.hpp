@@ -0,0 +1,61 @@
+#ifndef HIDO_SERVER_INPUTQUEUE_HPP
+#define HIDO_SERVER_INPUTQUEUE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "network.hpp"
+
+// ticks a missing input is waited for before it's considered lost
+constexpr uint32_t INPUT_JITTER_TICKS = 2;
+// inputs applied per tick, enough to catch up after jitter, the rest wait
+// for later ticks
+constexpr size_t MAX_INPUTS_PER_TICK = 1 + INPUT_JITTER_TICKS;
+// seconds of movement a client can bank, its inputs can't move it further
+// than the ticks that actually passed plus this jitter allowance
+constexpr float MAX_INPUT_BUDGET = MAX_INPUTS_PER_TICK * TICK_DT;
+
+/**
+ * Ring of a client's inputs indexed by sequence number. Inputs come out in
+ * sequence order and each one exactly once.
+ */
+class InputQueue {
+  public:
+    /**
+     * Inputs more than INPUT_QUEUE_SIZE ahead of the next one move the
+     * queue up to them, the ones skipped over are considered lost
+     * @returns false if the input is a duplicate or was already consumed
+     */
+    bool push(const InputPacket &input);
+
+    /**
+     * @returns the next input in sequence or nullptr if it hasn't arrived
+     */
+    const InputPacket *pop();
+
+    /**
+     * Call once per tick after popping, skips inputs that have been missing
+     * for longer than INPUT_JITTER_TICKS
+     */
+    void end_tick();
+
+    // newest input consumed, sent back so the client can trim its history,
+    // 0 until the first input arrives
+    uint32_t last_consumed() const {
+        return next == 0 ? 0 : next - 1;
+    }
+
+  private:
+    bool has(uint32_t sequence) const {
+        return inputs[sequence % INPUT_QUEUE_SIZE].sequence == sequence;
+    }
+
+    std::array<InputPacket, INPUT_QUEUE_SIZE> inputs;
+    // next sequence to consume, 0 until the first input arrives
+    uint32_t next = 0;
+    uint32_t newest = 0;
+    uint32_t stalled_ticks = 0;
+};
+
+#endif // HIDO_SERVER_INPUTQUEUE_HPP
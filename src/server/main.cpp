@@ -1,14 +1,74 @@
+#include <spdlog/spdlog.h>
+
 #include <csignal>
+#include <memory>
+#include <stdexcept>
+#include <string>
 
 #include "network.hpp"
 #include "server.hpp"
+#include "trace.hpp"
 
-Server live_stream(PORT);
+std::unique_ptr<Server> live_stream;
 void handler(int s) {
-    live_stream.shutdown();
+    live_stream->shutdown();
+}
+
+namespace {
+
+void profile_handler(int) {
+    live_stream->request_profile_report();
+}
+
+void trace_handler(int) {
+    trace_request_flush();
 }
 
-int main() {
+} // namespace
+
+int main(int argc, char **argv) {
+    // feed a capture back through the simulation and exit
+    if (argc > 1 && std::string(argv[1]) == "replay") {
+        if (argc != 3) {
+            spdlog::error("Invalid usage: ./hido replay <capture file>");
+            return -1;
+        }
+        CaptureReader reader;
+        if (!reader.open(argv[2])) return -1;
+        Server server(reader.get_max_players());
+        return server.replay(reader) ? 0 : -1;
+    }
+
+    if (argc > 6) {
+        spdlog::error("Invalid usage: ./hido [port] [max players] "
+                      "[profile seconds] [trace file] [capture file]");
+        return -1;
+    }
+    int port = PORT;
+    size_t max_players = DEFAULT_MAX_PLAYERS;
+    // off unless given or negative, 0 only reports on SIGUSR2
+    int profile_seconds = -1;
+    try {
+        if (argc > 1) port = std::stoi(argv[1]);
+        if (argc > 2) max_players = std::stoul(argv[2]);
+        if (argc > 3) profile_seconds = std::stoi(argv[3]);
+    } catch (std::invalid_argument const &e) {
+        spdlog::error("std::invalid argument: {}", e.what());
+        return -1;
+    } catch (std::out_of_range const &e) {
+        spdlog::error("std::out_of_range: {}", e.what());
+        return -1;
+    }
+    // - skips the trace file
+    bool trace = argc > 4 && std::string(argv[4]) != "-";
+    if (trace && !trace_start(argv[4], "hido")) return -1;
+    trace_thread_name("serve");
+    live_stream = std::make_unique<Server>(port, max_players);
+    if (profile_seconds >= 0) {
+        live_stream->enable_profiling(profile_seconds * 1000ULL);
+    }
+    if (argc > 5 && !live_stream->enable_capture(argv[5])) return -1;
+
     // SIGNAL INTERRUPT HANDLER
     // https://stackoverflow.com/questions/1641182/how-can-i-catch-a-ctrl-c-event
     struct sigaction sig_int_handler;
@@ -18,7 +78,23 @@ int main() {
     sig_int_handler.sa_flags = 0;
 
     sigaction(SIGINT, &sig_int_handler, NULL);
-    live_stream.serve();
+
+    // report the profile on demand
+    struct sigaction sig_usr2_handler;
+    sig_usr2_handler.sa_handler = profile_handler;
+    sigemptyset(&sig_usr2_handler.sa_mask);
+    sig_usr2_handler.sa_flags = 0;
+    sigaction(SIGUSR2, &sig_usr2_handler, NULL);
+
+    // write out the trace so far on demand
+    struct sigaction sig_usr1_handler;
+    sig_usr1_handler.sa_handler = trace_handler;
+    sigemptyset(&sig_usr1_handler.sa_mask);
+    sig_usr1_handler.sa_flags = 0;
+    sigaction(SIGUSR1, &sig_usr1_handler, NULL);
+
+    live_stream->serve();
+    trace_stop();
 
     return 0;
 }
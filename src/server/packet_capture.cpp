@@ -0,0 +1,123 @@
+#include "packet_capture.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+
+namespace {
+
+// largest record, a datagram header and a full packet
+constexpr size_t MAX_RECORD_SIZE = 1 + 8 + 4 + 2 + 2 + ETHERNET_MTU;
+
+template <typename T>
+uint8_t *put(uint8_t *out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        *out++ = (uint8_t)(value >> (8 * i));
+    }
+    return out;
+}
+
+template <typename T>
+bool get(FILE *file, T &value) {
+    uint8_t bytes[sizeof(T)];
+    if (std::fread(bytes, 1, sizeof(T), file) != sizeof(T)) return false;
+    value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value |= (T)bytes[i] << (8 * i);
+    }
+    return true;
+}
+
+} // namespace
+
+CaptureWriter::~CaptureWriter() {
+    if (file != nullptr) std::fclose(file);
+}
+
+bool CaptureWriter::open(const std::string &path, size_t max_players) {
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        spdlog::error("Failed to open capture file: '{}'.", path);
+        return false;
+    }
+    // records are small, buffer plenty of them per write
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    uint8_t header[sizeof(CAPTURE_MAGIC) + 4];
+    std::memcpy(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    put<uint32_t>(header + sizeof(CAPTURE_MAGIC), max_players);
+    std::fwrite(header, 1, sizeof(header), file);
+    start = get_now_nanos();
+    spdlog::info("Capturing to '{}'.", path);
+    return true;
+}
+
+void CaptureWriter::datagram(const sockaddr_in &from,
+                             const Packet &packet,
+                             size_t len) {
+    if (file == nullptr) return;
+    uint8_t record[MAX_RECORD_SIZE];
+    uint8_t *out = record;
+    out = put<uint8_t>(out, (uint8_t)CaptureRecordType::DATAGRAM);
+    out = put<uint64_t>(out, get_now_nanos() - start);
+    out = put<uint32_t>(out, from.sin_addr.s_addr);
+    out = put<uint16_t>(out, from.sin_port);
+    out = put<uint16_t>(out, len);
+    std::memcpy(out, packet.data(), len);
+    std::fwrite(record, 1, out - record + len, file);
+}
+
+void CaptureWriter::tick(uint64_t expirations) {
+    if (file == nullptr) return;
+    uint8_t record[1 + 8 + 4];
+    uint8_t *out = record;
+    out = put<uint8_t>(out, (uint8_t)CaptureRecordType::TICK);
+    out = put<uint64_t>(out, get_now_nanos() - start);
+    put<uint32_t>(out, expirations);
+    std::fwrite(record, 1, sizeof(record), file);
+}
+
+CaptureReader::~CaptureReader() {
+    if (file != nullptr) std::fclose(file);
+}
+
+bool CaptureReader::open(const std::string &path) {
+    file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        spdlog::error("Failed to open capture file: '{}'.", path);
+        return false;
+    }
+    char magic[sizeof(CAPTURE_MAGIC)];
+    uint32_t players = 0;
+    if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        std::memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0 ||
+        !get(file, players)) {
+        spdlog::error("Not a capture file: '{}'.", path);
+        return false;
+    }
+    max_players = players;
+    return true;
+}
+
+bool CaptureReader::next(CaptureRecord &record) {
+    uint8_t type = 0;
+    // a clean end of file is only allowed between records
+    if (!get(file, type)) return false;
+    record.type = (CaptureRecordType)type;
+    bool ok = get(file, record.time);
+    if (ok && record.type == CaptureRecordType::DATAGRAM) {
+        uint16_t len = 0;
+        record.addr = {};
+        record.addr.sin_family = AF_INET;
+        ok = get(file, record.addr.sin_addr.s_addr) &&
+             get(file, record.addr.sin_port) && get(file, len) &&
+             len <= record.packet.size() &&
+             std::fread(record.packet.data(), 1, len, file) == len;
+        record.len = len;
+    } else if (ok && record.type == CaptureRecordType::TICK) {
+        ok = get(file, record.expirations);
+    } else {
+        ok = false;
+    }
+    malformed = !ok;
+    return ok;
+}
@@ -0,0 +1,101 @@
+#ifndef HIDO_SERVER_PACKETCAPTURE_HPP
+#define HIDO_SERVER_PACKETCAPTURE_HPP
+
+#include <netinet/in.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "network.hpp"
+
+// a capture starts with these 8 bytes then the server's max players, the
+// digit is the format version
+constexpr char CAPTURE_MAGIC[8] = {'H', 'I', 'D', 'O', 'C', 'A', 'P', '1'};
+
+// everything that drives the simulation, in the order the server saw it
+enum class CaptureRecordType : uint8_t {
+    DATAGRAM,
+    TICK,
+};
+
+struct CaptureRecord {
+    CaptureRecordType type = CaptureRecordType::DATAGRAM;
+    // nanos since the capture started
+    uint64_t time = 0;
+    // datagrams only
+    sockaddr_in addr{};
+    Packet packet;
+    size_t len = 0;
+    // ticks only, timer expirations the tick caught up on
+    uint32_t expirations = 0;
+};
+
+/**
+ * Appends every inbound datagram and tick to a binary log of little endian
+ * fields. Every call returns straight away unless a file is open.
+ * Datagram records: type u8, time u64, address u32, port u16, length u16,
+ * then the bytes, address and port as sockaddr_in holds them.
+ * Tick records: type u8, time u64, expirations u32.
+ */
+class CaptureWriter {
+  public:
+    CaptureWriter() = default;
+    ~CaptureWriter();
+    CaptureWriter(const CaptureWriter &) = delete;
+    CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+    /**
+     * @returns false if the file couldn't be opened
+     */
+    bool open(const std::string &path, size_t max_players);
+
+    bool is_open() const {
+        return file != nullptr;
+    }
+
+    void datagram(const sockaddr_in &from, const Packet &packet, size_t len);
+    void tick(uint64_t expirations);
+
+  private:
+    FILE *file = nullptr;
+    uint64_t start = 0;
+};
+
+/**
+ * Reads a capture back one record at a time
+ */
+class CaptureReader {
+  public:
+    CaptureReader() = default;
+    ~CaptureReader();
+    CaptureReader(const CaptureReader &) = delete;
+    CaptureReader &operator=(const CaptureReader &) = delete;
+
+    /**
+     * @returns false if the file can't be read or isn't a capture
+     */
+    bool open(const std::string &path);
+
+    size_t get_max_players() const {
+        return max_players;
+    }
+
+    /**
+     * @returns false at the end of the capture or on a malformed record
+     */
+    bool next(CaptureRecord &record);
+
+    // false if reading stopped at a malformed record
+    bool ok() const {
+        return !malformed;
+    }
+
+  private:
+    FILE *file = nullptr;
+    size_t max_players = 0;
+    bool malformed = false;
+};
+
+#endif // HIDO_SERVER_PACKETCAPTURE_HPP
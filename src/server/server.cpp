@@ -1,5 +1,6 @@
 #include "server.hpp"
 
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <poll.h>
 #include <raymath.h>
@@ -7,8 +8,12 @@
 #include <sys/epoll.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -19,8 +24,17 @@
 #include "server/client_manager.hpp"
 #include "state/bullet.hpp"
 #include "state/player.hpp"
+#include "trace.hpp"
 
-Server::Server(uint32_t port) {
+Server::Server(uint32_t port, size_t max_players)
+    : max_players(std::min(max_players, MAX_CLIENTS)) {
+    // the profiler counts datagrams as they're queued
+    send_batch.on_drop([this](const Packet &packet, size_t len) {
+        PacketHeader header;
+        if (peek_header(packet, len, header)) {
+            profiler.count_dropped(header.type, len);
+        }
+    });
     // SOCK_DGRAM: Datagram sockets are for UDP (different order/duplicate msgs)
     // SOCK_STREAM: TCP sequenced, constant, 2 way stream of data
     // SOCK_RAW: ICMP, not used
@@ -32,6 +46,8 @@ Server::Server(uint32_t port) {
         return;
     }
     spdlog::info("Successfully created socket.");
+    // non-blocking so the socket can be drained in batches
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
 
     sockaddr_in addr;
     addr.sin_family = AF_INET;
@@ -55,96 +71,271 @@ Server::Server(uint32_t port) {
         return;
     }
 
-    spdlog::info("Listening on port {}.", port);
+    // fixed tick timer, shares the epoll set with the socket
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    ev.events = EPOLLIN;
+    ev.data.fd = tfd;
+    if (tfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0) {
+        spdlog::error("Error creating tick timer.");
+        running = false;
+        return;
+    }
+
+    spdlog::info(
+        "Listening on port {}, up to {} players.", port, this->max_players);
 }
 
+Server::Server(size_t max_players)
+    : max_players(std::min(max_players, MAX_CLIENTS)) {}
+
 Server::~Server() {
+    close(tfd);
     close(epfd);
     close(sock);
 }
 
+bool Server::load_map() {
+    map = std::make_unique<GameMap>("./res/map/map1.tmx", "./res/map");
+    // positions outside it would be clamped on the wire
+    float width = map->width * map->tileWidth;
+    float height = map->height * map->tileHeight;
+    if (WORLD_MIN > 0.0f || width > WORLD_MAX || height > WORLD_MAX) {
+        spdlog::error("Map of {}x{} pixels doesn't fit the world of {} to {}.",
+                      width,
+                      height,
+                      WORLD_MIN,
+                      WORLD_MAX);
+        return false;
+    }
+
+    // one grid cell per tile, doubled on big maps to bound the grid size
+    uint32_t tiles_per_cell = 1;
+    while ((map->width / tiles_per_cell) * (map->height / tiles_per_cell) >
+           MAX_GRID_CELLS) {
+        tiles_per_cell *= 2;
+    }
+    hitbox_history.configure(map->tileWidth * tiles_per_cell,
+                             map->tileHeight * tiles_per_cell,
+                             map->width / tiles_per_cell + 1,
+                             map->height / tiles_per_cell + 1);
+    return true;
+}
+
 void Server::serve() {
     const size_t MAX_EVENTS = 10;
     epoll_event events[MAX_EVENTS];
 
-    auto last_t = std::chrono::steady_clock::now();
-
-    map = std::make_unique<GameMap>("./res/map/map1.tmx", "./res/map");
+    if (!load_map()) return;
 
     while (running) {
-        // wait time of 0 causes return immediately
-        // TODO: wait a little to not hog CPU
-        int n_ready = epoll_wait(epfd, events, MAX_EVENTS, 10);
-        if (n_ready <= 0) continue;
+        profiler.poll(get_now_millis());
+        trace_poll();
+        // block until packets arrive or the tick timer fires, the timer is
+        // disarmed while nobody is connected so an empty server sleeps
+        int n_ready;
+        {
+            ProfileZone zone(profiler, TickPhase::WAIT);
+            n_ready = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        }
+        // interrupted by shutdown or a signal
+        if (n_ready < 0) continue;
 
+        uint64_t expirations = 0;
         for (int i = 0; i < n_ready; ++i) {
-            if (events[i].events & EPOLLIN) {
+            if (!(events[i].events & EPOLLIN)) continue;
+            if (events[i].data.fd == sock) {
                 process_events();
+            } else if (events[i].data.fd == tfd) {
+                uint64_t n = 0;
+                if (read(tfd, &n, sizeof(n)) == sizeof(n)) {
+                    expirations += n;
+                }
             }
         }
-
-        // update the game
-        auto now = std::chrono::steady_clock::now();
-        double accumulate =
-            std::chrono::duration_cast<std::chrono::duration<double>>(now -
-                                                                      last_t)
-                .count();
-        const float dt = TICK_INTERVAL / 1000.0f;
-        while (accumulate >= dt) {
-            accumulate -= dt;
-            update(dt);
-            // track last update only
-            last_t = std::chrono::steady_clock::now();
+        if (expirations > 0) {
+            capture.tick(expirations);
+            tick(expirations);
         }
-        uint64_t timestamp = get_now_millis();
-        send_game_state(timestamp);
-        send_bullet_state(timestamp);
+        update_tick_timer();
+        ProfileZone zone(profiler, TickPhase::FLUSH);
+        send_batch.flush(sock);
     }
 }
 
+void Server::tick(uint64_t expirations) {
+    TraceZone zone("tick");
+    // catch up after a stall, but never spiral trying to
+    uint64_t steps = std::min(expirations, MAX_CATCHUP_TICKS);
+    if (steps < expirations) {
+        spdlog::warn("Server fell behind, skipping {} ticks.",
+                     expirations - steps);
+    }
+    profiler.begin_tick(expirations);
+    for (uint64_t i = 0; i < steps; ++i) {
+        tick_count++;
+        update();
+    }
+    // snapshots go out once per tick
+    uint64_t timestamp = get_now_millis();
+    send_game_state(timestamp);
+    profiler.end_tick();
+}
+
+void Server::update_tick_timer() {
+    bool should_tick = manager.count() > 0;
+    if (should_tick == ticking) return;
+
+    itimerspec spec{};
+    if (should_tick) {
+        spec.it_interval.tv_nsec = TICK_INTERVAL * 1000000L;
+        spec.it_value = spec.it_interval;
+    }
+    // zeroed spec disarms the timer
+    timerfd_settime(tfd, 0, &spec, nullptr);
+    if (should_tick) profiler.timer_armed(TICK_INTERVAL * 1000000L);
+    ticking = should_tick;
+}
+
 void Server::shutdown() {
     spdlog::info("Shutting down.");
     running = false;
 }
 
-void Server::process_events() {
-    sockaddr_in client_addr{};
-    socklen_t len = sizeof(client_addr);
+void Server::enable_profiling(uint64_t report_interval) {
+    profiler.enable(report_interval);
+}
 
-    Packet packet;
-    // get packet
-    int n = recvfrom(
-        sock, packet.data(), packet.size(), 0, (sockaddr *)&client_addr, &len);
-    // WARN: only since UDP sends entire packets, we can assume everything
-    // arrived
-    if (n <= 0) {
-        return;
+void Server::request_profile_report() {
+    profiler.request_report();
+}
+
+bool Server::enable_capture(const std::string &path) {
+    return capture.open(path, max_players);
+}
+
+bool Server::replay(CaptureReader &reader) {
+    if (!load_map()) return false;
+    profiler.enable(0);
+
+    CaptureRecord record;
+    uint64_t datagrams = 0, ticks = 0, captured = 0;
+    // FNV-1a offset basis
+    uint64_t checksum = 14695981039346656037ull;
+    uint64_t start = get_now_nanos();
+    while (reader.next(record)) {
+        if (record.type == CaptureRecordType::DATAGRAM) {
+            ProfileZone zone(profiler, TickPhase::PROCESS_EVENTS);
+            process_packet(record.packet, record.addr, record.len);
+            datagrams++;
+        } else {
+            tick(record.expirations);
+            // nothing to send to, this just drops it
+            send_batch.flush(sock);
+            checksum = world_checksum(checksum);
+            ticks++;
+        }
+        captured = record.time;
     }
-    // get header
-    PacketHeader *header = get_header(packet);
-    std::vector<BulletPacket> bullet_packets;
+    double seconds = (get_now_nanos() - start) / 1e9;
+
+    spdlog::info("Replayed {} datagrams and {} ticks in {:.3f}s, {:.1f}x "
+                 "the {:.1f}s captured.",
+                 datagrams,
+                 ticks,
+                 seconds,
+                 captured / 1e9 / seconds,
+                 captured / 1e9);
+    spdlog::info("World checksum {:016x} after tick {}.", checksum, tick_count);
+    profiler.request_report();
+    profiler.poll(get_now_millis());
+    if (!reader.ok()) {
+        spdlog::error("Capture ends in a malformed record.");
+    }
+    return reader.ok();
+}
+
+uint64_t Server::world_checksum(uint64_t hash) {
+    // FNV-1a over each field, structs have padding
+    auto fold = [&](auto value) {
+        const uint8_t *bytes = (const uint8_t *)&value;
+        for (size_t i = 0; i < sizeof(value); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    for (const ClientAddr &client : manager.get_clients()) {
+        const PlayerState &p = client.player;
+        fold(p.id);
+        fold(p.rect.x);
+        fold(p.rect.y);
+        fold(p.health);
+    }
+    std::vector<BulletState> in_flight;
+    bullets.get_bullets(in_flight);
+    for (const BulletState &b : in_flight) {
+        fold(b.id);
+        fold(b.origin.x);
+        fold(b.origin.y);
+        fold(b.vel.x);
+        fold(b.vel.y);
+        fold(b.spawn_tick);
+        fold(b.impact_tick);
+    }
+    return hash;
+}
 
-    // set the client/sender id
-    if (manager.count() >= MAX_PLAYERS) {
-        spdlog::warn("Game server already hosting max of {} players.",
-                     MAX_PLAYERS);
+void Server::process_events() {
+    ProfileZone zone(profiler, TickPhase::PROCESS_EVENTS);
+    // drain everything that queued up since the last wake
+    while (true) {
+        int n = recv_batch.receive(sock);
+        for (int i = 0; i < n; ++i) {
+            // WARN: only since UDP sends entire packets, we can assume
+            // everything arrived
+            if (recv_batch.length(i) == 0) continue;
+            capture.datagram(recv_batch.addr(i),
+                             recv_batch.packet(i),
+                             recv_batch.length(i));
+            process_packet(recv_batch.packet(i),
+                           recv_batch.addr(i),
+                           recv_batch.length(i));
+        }
+        // a short batch means the socket is empty
+        if (n < (int)PACKET_BATCH_SIZE) break;
+    }
+}
+
+void Server::process_packet(Packet &packet,
+                            const sockaddr_in &client_addr,
+                            size_t len) {
+    // get header
+    PacketHeader header;
+    if (!peek_header(packet, len, header)) {
         return;
     }
+    profiler.count_in(header.type, len);
+    trace_instant(packet_type_name(header.type), len);
 
     // CONNECT PACKET
-    if (header->type == PacketType::CLIENT_CONNECT) {
+    if (header.type == PacketType::CLIENT_CONNECT) {
+        ClientPacket client_packet;
+        if (!deserialize(packet, len, client_packet)) return;
+        // only new players are turned away, reconnects are acknowledged
+        if (manager.count() >= max_players &&
+            manager.get(client_addr) == nullptr) {
+            spdlog::warn("Game server already hosting max of {} players.",
+                         max_players);
+            return;
+        }
         // add or return if client already exists
-        ClientAddr *c = manager.add(
-            client_addr, get_packet_data<ClientPacket>(packet)->name);
-        // returns the id
-        header->sender = c->id;
+        ClientAddr *c = manager.add(client_addr, client_packet.name);
+        if (c == nullptr) return;
+        // returns the id, and the tick to expand sequences from
+        client_packet.header.sender = c->id;
+        client_packet.tick = tick_count;
         // resend the packet back to "acknowledge" it
-        sendto(sock,
-               packet.data(),
-               sizeof(ClientPacket),
-               0,
-               (sockaddr *)&c->addr,
-               sizeof(c->addr));
+        size_t n = serialize(client_packet, packet);
+        send_batch.push(sock, packet.data(), n, c->addr);
+        profiler.count_out(PacketType::CLIENT_CONNECT, n);
         return;
     }
     ClientAddr *c = manager.get(client_addr);
@@ -152,151 +343,172 @@ void Server::process_events() {
     if (c == nullptr) {
         return;
     }
-    // TODO: remove this, client should know its id
-    // return the id
-    header->sender = c->id;
-
-    if (header->type == PacketType::INPUT) {
-        // update last input packet for the corresponding client
-        InputPacket *input_packet = get_packet_data<InputPacket>(packet);
-        if (input_packet->header.timestamp > c->last_input.header.timestamp) {
-            c->last_input = *input_packet;
-            c->player.id = c->id;
+
+    if (header.type == PacketType::INPUT) {
+        InputBatch batch;
+        if (!deserialize(packet,
+                         len,
+                         batch,
+                         c->inputs.last_consumed(),
+                         tick_count)) {
+            return;
         }
+        c->ack_snapshot = std::max(c->ack_snapshot, batch.ack_snapshot);
+        // applied in sequence order on the next tick, inputs repeated from
+        // earlier batches are dropped as duplicates
+        for (size_t i = 0; i < batch.count; ++i) {
+            c->inputs.push(batch.inputs[i]);
+        }
+        return;
+    }
+
+    // PING PACKET
+    if (header.type == PacketType::PING) {
+        PingPacket ping;
+        if (!deserialize(packet, len, ping)) return;
+        // stamp it and echo it back, the client works out the rest
+        ping.server_time = get_now_millis();
+        size_t n = serialize(ping, packet);
+        send_batch.push(sock, packet.data(), n, c->addr);
+        profiler.count_out(PacketType::PING, n);
         return;
     }
 
     // DISCONNECT PACKET
-    if (header->type == PacketType::CLIENT_DISCONNECT) {
-        manager.remove(*c);
+    if (header.type == PacketType::CLIENT_DISCONNECT) {
         // resend the packet back to "acknowledge" it
-        sendto(sock,
-               packet.data(),
-               sizeof(ClientPacket),
-               0,
-               (sockaddr *)&c->addr,
-               sizeof(c->addr));
+        send_batch.push(sock, packet.data(), len, c->addr);
+        profiler.count_out(PacketType::CLIENT_DISCONNECT, len);
+        manager.remove(*c);
     }
 }
 
-void Server::update(float dt) {
-    // update clients with last input
-    for (auto &client : manager.get_clients()) {
-        auto &player = client.second.player;
-        auto &input = client.second.last_input;
-        Vector2 vel{(input.right - input.left) * PLAYER_SPEED,
-                    (input.down - input.up) * PLAYER_SPEED};
-        player_update(player, vel, dt, *map);
-        // create bullets when mouse down
-        if (input.mouse_down) {
-            Vector2 direction = Vector2Subtract(input.mouse_pos,
-                                                {player.rect.x, player.rect.y});
-            direction = Vector2Normalize(direction);
-            Vector2 vel = Vector2Scale(direction, 300.0f);
-            uint64_t t = get_now_millis();
-            bullet_state.push_back(
-                BulletState{t,
-                            player.id,
-                            bullet_idx++,
-                            Vector2{player.rect.x + player.rect.width / 2.0f,
-                                    player.rect.y + player.rect.height / 2.0f},
-                            vel});
-        }
-    }
-    // move bullets
-    for (auto itr = bullet_state.begin(); itr != bullet_state.end(); ++itr) {
-        bool wall_collision = bullet_update(*itr, dt, *map);
-        if (wall_collision) {
-            // smart erase is marginally faster than classic erase despite
-            // memmove optimizations
-            std::swap(*itr, bullet_state.back());
-            bullet_state.pop_back();
-            itr--;
+void Server::apply_input(ClientAddr &client, const InputPacket &input) {
+    auto &player = client.player;
+    Vector2 vel{(input.right - input.left) * PLAYER_SPEED,
+                (input.down - input.up) * PLAYER_SPEED};
+    // same dt the client predicted with, so reconciliation agrees, unless
+    // it claims more time than has passed
+    float dt = std::min(input.dt, client.input_budget);
+    client.input_budget -= dt;
+    player_update(player, vel, dt, *map);
+    // create bullets when mouse down
+    if (input.mouse_down) {
+        Vector2 direction =
+            Vector2Subtract(input.mouse_pos, {player.rect.x, player.rect.y});
+        direction = Vector2Normalize(direction);
+        Vector2 vel = Vector2Scale(direction, BULLET_SPEED);
+        Vector2 origin{player.rect.x + player.rect.width / 2.0f,
+                       player.rect.y + player.rect.height / 2.0f};
+        // the shooter saw others interpolated behind the server, at the
+        // tick their client reports
+        uint32_t rewind_ticks = 0;
+        if (input.view_tick != 0 && tick_count > input.view_tick) {
+            rewind_ticks = tick_count - input.view_tick;
         }
+        // the path is fixed, so find where it ends once instead of checking
+        // the map every tick, bullets that fly too long or far expire early
+        float flight_time =
+            std::min({bullet_impact_time(origin, vel, *map),
+                      BULLET_LIFETIME,
+                      BULLET_RANGE / Vector2Length(vel)});
+        uint32_t flight_ticks = std::min(std::ceil(flight_time / TICK_DT),
+                                         (float)MAX_FLIGHT_TICKS);
+        BulletState bullet;
+        bullet.sender = player.id;
+        bullet.origin = origin;
+        bullet.vel = vel;
+        bullet.spawn_tick = tick_count;
+        bullet.impact_tick = tick_count + flight_ticks;
+        bullet.rewind_ticks = rewind_ticks;
+        // shots are dropped while the pool is full
+        bullets.spawn(bullet);
     }
-    // check if bullets hit any clients
-    for (auto itr = bullet_state.begin(); itr != bullet_state.end(); ++itr) {
-        for (auto &client : manager.get_clients()) {
-            // check if client and bullet have reasonable timestamp similarity
-            uint64_t a = itr->timestamp,
-                     b = client.second.last_input.header.timestamp;
-            uint64_t diff = a > b ? a - b : b - a;
-            // if they're within a frame
-            if (std::abs((int64_t)diff) > TICK_INTERVAL) {
-                continue;
-            }
+    client.last_input = input;
+}
 
-            auto &player = client.second.player;
-            // only non-player's bullets can hurt
-            if (player.id == itr->sender) continue;
-            if (CheckCollisionRecs(
-                    player.rect,
-                    {itr->pos.x, itr->pos.y, BULLET_SIZE, BULLET_SIZE})) {
-                // smart erase is marginally faster than classic erase despite
-                // memmove optimizations
-                std::swap(*itr, bullet_state.back());
-                bullet_state.pop_back();
-                itr--;
-                player.health -= 0.2f;
-            }
+void Server::update() {
+    ProfileZone zone(profiler, TickPhase::UPDATE);
+    // apply the inputs that arrived since the last tick, in order, a few at
+    // most so a client can't run ahead of the server's clock
+    for (auto &client : manager.get_clients()) {
+        client.input_budget =
+            std::min(client.input_budget + TICK_DT, MAX_INPUT_BUDGET);
+        for (size_t i = 0; i < MAX_INPUTS_PER_TICK; ++i) {
+            const InputPacket *input = client.inputs.pop();
+            if (input == nullptr) break;
+            apply_input(client, *input);
         }
+        client.inputs.end_tick();
     }
+    // remember where everyone is for lag compensated hits
+    HitboxFrame &hitboxes = hitbox_history.record(tick_count);
+    for (auto &client : manager.get_clients()) {
+        hitboxes.push(client.id, client.player.rect);
+    }
+    hitboxes.build_grid();
+    // place every bullet for this tick in one pass, then they're gone once
+    // they reach a wall, expire or hit someone where the shooter saw them
+    bullets.advance(tick_count);
+    bullets.remove_if([&](size_t i) {
+        if (bullets.expired(i)) return true;
+        const HitboxFrame &frame =
+            hitbox_history.rewind(tick_count, bullets.rewind(i));
+        int hit = frame.hit_test(bullets.rect(i), bullets.sender(i));
+        if (hit < 0) return false;
+        // they may have left since
+        ClientAddr *target = manager.find_by_id(hit);
+        if (target != nullptr) {
+            target->player.health -= 0.2f;
+        }
+        return true;
+    });
 }
 
 void Server::send_game_state(uint64_t timestamp) {
+    ProfileZone zone(profiler, TickPhase::SEND_GAME_STATE);
     // send clients the updates
     GameStatePacket gsp;
     gsp.header.type = PacketType::GAME_STATE;
-    gsp.header.timestamp = timestamp;
-    gsp.num_players = manager.count();
+    gsp.timestamp = timestamp;
+    gsp.sequence = tick_count;
+    bullets.get_bullets(gsp.bullets);
+    std::sort(gsp.bullets.begin(),
+              gsp.bullets.end(),
+              [](const BulletState &a, const BulletState &b) {
+                  return a.id < b.id;
+              });
 
     // add them in sorted order
-    size_t i = 0;
+    gsp.players.reserve(manager.count());
     for (auto &client : manager.get_clients()) {
-        gsp.players[i++] = client.second.player;
+        gsp.players.push_back(client.player);
     }
+    std::sort(gsp.players.begin(),
+              gsp.players.end(),
+              [](const PlayerState &a, const PlayerState &b) {
+                  return a.id < b.id;
+              });
+    snapshot_history.store(gsp);
 
-    // create the packet and send it
-    Packet packet = create_packet_from<GameStatePacket>(gsp);
+    Packet packet;
     for (auto &client : manager.get_clients()) {
         // update the client_id to tell the client what their id is
-        gsp.client_id = client.first;
-        size_t offset = offsetof(GameStatePacket, client_id);
-        memcpy(packet.data() + offset, &client.first, sizeof(gsp.client_id));
-
-        // send the packet
-        sendto(sock,
-               packet.data(),
-               sizeof(GameStatePacket),
-               0,
-               (sockaddr *)&client.second.addr,
-               sizeof(client.second.addr));
-    }
-}
+        gsp.client_id = client.id;
+        gsp.input_ack = client.inputs.last_consumed();
 
-void Server::send_bullet_state(uint64_t timestamp) {
-    BulletStatePacket bsp;
-    bsp.header.type = PacketType::BULLET;
-    bsp.header.timestamp = timestamp;
-    bsp.num_bullets = std::min(MAX_BULLETS_PER_PACKET, bullet_state.size());
-    // TODO: alternate sending bullets every frame for more space
-    // add bullet packets
-    for (size_t i = 0; i < bsp.num_bullets; ++i) {
-        // copy sender, id and pos
-        bsp.bullets[i].sender = bullet_state[i].sender;
-        bsp.bullets[i].id = bullet_state[i].id;
-        bsp.bullets[i].pos = bullet_state[i].pos;
-    }
-    Packet packet = create_packet_from<BulletStatePacket>(bsp);
-    // send packet to clients
-    for (auto &client : manager.get_clients()) {
-        // send the packet
-        sendto(sock,
-               packet.data(),
-               sizeof(bsp.header) + sizeof(bsp.num_bullets) +
-                   sizeof(BulletPacket) * bsp.num_bullets,
-               0,
-               (sockaddr *)&client.second.addr,
-               sizeof(client.second.addr));
+        // delta against what the client last acknowledged if we still have it
+        uint32_t ack = client.ack_snapshot;
+        const GameStatePacket *baseline = nullptr;
+        if (ack != 0 && gsp.sequence - ack < SNAPSHOT_HISTORY) {
+            baseline = snapshot_history.find(ack);
+        }
+        // queue the fragments, flushed once per loop
+        encode_game_state(
+            gsp, baseline, packet, [&](const Packet &fragment, size_t len) {
+                send_batch.push(
+                    sock, fragment.data(), len, client.addr);
+                profiler.count_out(PacketType::GAME_STATE, len);
+            });
     }
 }
@@ -7,36 +7,103 @@
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <string>
 
 #include "map/map.hpp"
+#include "packet_batch.hpp"
+#include "server/bullet_pool.hpp"
 #include "server/client_manager.hpp"
+#include "server/hitbox_history.hpp"
+#include "server/packet_capture.hpp"
+#include "server/tick_profiler.hpp"
+#include "snapshot.hpp"
 #include "state/bullet.hpp"
 
 class Server {
   public:
-    Server(uint32_t port);
+    Server(uint32_t port, size_t max_players = DEFAULT_MAX_PLAYERS);
+    /**
+     * A server without a socket, for replaying captures
+     */
+    explicit Server(size_t max_players);
     ~Server();
 
     void client_accept();
     void serve();
     void shutdown();
 
+    /**
+     * Times every phase of the loop and counts traffic, logging a report
+     * every report_interval millis, or only when asked if it's 0
+     */
+    void enable_profiling(uint64_t report_interval);
+    // safe to call from a signal handler
+    void request_profile_report();
+
+    /**
+     * Records every datagram received and every tick to a file, so the
+     * session can be replayed
+     * @returns false if the file couldn't be opened
+     */
+    bool enable_capture(const std::string &path);
+
+    /**
+     * Feeds a capture through the simulation as fast as it goes, then logs
+     * how long it took, the profile of every phase and a checksum of the
+     * world after every tick, which only changes if the simulation does
+     * @returns false if the capture ended in a malformed record
+     */
+    bool replay(CaptureReader &reader);
+
   private:
+    /**
+     * @returns false if the map doesn't fit the quantized world
+     */
+    bool load_map();
+    /**
+     * @param hash checksum to fold the world into
+     * @returns the hash with every player and bullet folded in
+     */
+    uint64_t world_checksum(uint64_t hash);
     void process_events();
-    void update(float dt);
+    void process_packet(Packet &packet,
+                        const sockaddr_in &client_addr,
+                        size_t len);
+    void tick(uint64_t expirations);
+    void update_tick_timer();
+    void apply_input(ClientAddr &client, const InputPacket &input);
+    void update();
     void send_game_state(uint64_t timestamp);
-    void send_bullet_state(uint64_t timestamp);
 
-    int sock = 0;
-    int epfd = 0;
+    int sock = -1;
+    int epfd = -1;
+    int tfd = -1;
     std::atomic<bool> running = true;
+    size_t max_players;
+
+    // ticks only run while there are clients to simulate for
+    bool ticking = false;
+    uint64_t tick_count = 0;
+    // most ticks simulated after a stall, the rest are dropped
+    constexpr static uint64_t MAX_CATCHUP_TICKS = 4;
 
     // world objects
     std::unique_ptr<GameMap> map = nullptr;
 
+    // reused across loop iterations, batches are large
+    RecvBatch recv_batch;
+    SendBatch send_batch;
+
     ClientManager manager;
-    std::vector<BulletState> bullet_state;
-    int bullet_idx = 0;
+    // world snapshots the clients' deltas are encoded against
+    SnapshotHistory snapshot_history;
+    // bullets in flight
+    BulletPool bullets;
+    // past player hitboxes to check bullets against
+    HitboxHistory hitbox_history;
+
+    TickProfiler profiler;
+    CaptureWriter capture;
 };
 
 #endif // HIDO_SERVER_SERVER_HPP
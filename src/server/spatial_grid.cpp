@@ -0,0 +1,49 @@
+#include "spatial_grid.hpp"
+
+void SpatialGrid::configure(float cell_width,
+                            float cell_height,
+                            uint32_t cols,
+                            uint32_t rows) {
+    inv_cell_width = 1.0f / cell_width;
+    inv_cell_height = 1.0f / cell_height;
+    this->cols = std::max(cols, 1u);
+    this->rows = std::max(rows, 1u);
+    cell_start.assign(this->cols * this->rows + 1, 0);
+    items.clear();
+}
+
+void SpatialGrid::build(const float *x,
+                        const float *y,
+                        const float *width,
+                        const float *height,
+                        size_t n) {
+    const size_t num_cells = cell_start.size() - 1;
+    cursor.assign(num_cells + 1, 0);
+
+    // count rects per cell
+    uint32_t x0, y0, x1, y1;
+    for (size_t i = 0; i < n; ++i) {
+        cell_range(x[i], y[i], width[i], height[i], x0, y0, x1, y1);
+        for (uint32_t cy = y0; cy <= y1; ++cy) {
+            for (uint32_t cx = x0; cx <= x1; ++cx) {
+                cursor[cy * cols + cx + 1]++;
+            }
+        }
+    }
+    // prefix sum gives each cell's start
+    for (size_t c = 0; c < num_cells; ++c) {
+        cursor[c + 1] += cursor[c];
+    }
+    cell_start = cursor;
+    items.resize(cursor[num_cells]);
+
+    // fill, cursor walks each cell forward
+    for (size_t i = 0; i < n; ++i) {
+        cell_range(x[i], y[i], width[i], height[i], x0, y0, x1, y1);
+        for (uint32_t cy = y0; cy <= y1; ++cy) {
+            for (uint32_t cx = x0; cx <= x1; ++cx) {
+                items[cursor[cy * cols + cx]++] = i;
+            }
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef HIDO_SERVER_SPATIALGRID_HPP
+#define HIDO_SERVER_SPATIALGRID_HPP
+
+#include <raylib.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// upper bound on grid cells, keeps a grid per tick of history cheap
+constexpr uint32_t MAX_GRID_CELLS = 4096;
+
+/**
+ * Uniform grid over the map for broadphase queries. Rebuilt from scratch
+ * each tick in two linear passes, cells are stored back to back so a build
+ * doesn't allocate once the buffers have grown.
+ */
+class SpatialGrid {
+  public:
+    /**
+     * @param cell_width width of a cell in pixels
+     * @param cell_height height of a cell in pixels
+     * @param cols cells across, anything past the edge lands in the last one
+     * @param rows cells down
+     */
+    void configure(float cell_width,
+                   float cell_height,
+                   uint32_t cols,
+                   uint32_t rows);
+
+    /**
+     * Indexes n rects given as parallel arrays, replacing the old contents
+     */
+    void build(const float *x,
+               const float *y,
+               const float *width,
+               const float *height,
+               size_t n);
+
+    /**
+     * Visits every cell sharing area with rect as a range of get_items(), so
+     * data gathered in item order can be tested in batches. A rect spanning
+     * several cells can be seen more than once.
+     * @param visit called with (begin, end), returns true to stop early
+     * @returns true if visit stopped early
+     */
+    template <typename F>
+    bool query_ranges(const Rectangle &rect, F &&visit) const {
+        uint32_t x0, y0, x1, y1;
+        cell_range(rect.x, rect.y, rect.width, rect.height, x0, y0, x1, y1);
+        for (uint32_t cy = y0; cy <= y1; ++cy) {
+            for (uint32_t cx = x0; cx <= x1; ++cx) {
+                uint32_t cell = cy * cols + cx;
+                if (cell_start[cell] == cell_start[cell + 1]) continue;
+                if (visit(cell_start[cell], cell_start[cell + 1])) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // indices of the built rects, grouped by cell
+    const std::vector<uint32_t> &get_items() const {
+        return items;
+    }
+
+  private:
+    void cell_range(float x,
+                    float y,
+                    float width,
+                    float height,
+                    uint32_t &x0,
+                    uint32_t &y0,
+                    uint32_t &x1,
+                    uint32_t &y1) const {
+        x0 = to_cell(x * inv_cell_width, cols);
+        x1 = to_cell((x + width) * inv_cell_width, cols);
+        y0 = to_cell(y * inv_cell_height, rows);
+        y1 = to_cell((y + height) * inv_cell_height, rows);
+    }
+
+    static uint32_t to_cell(float v, uint32_t count) {
+        return (uint32_t)std::clamp(v, 0.0f, (float)(count - 1));
+    }
+
+    float inv_cell_width = 1.0f, inv_cell_height = 1.0f;
+    uint32_t cols = 1, rows = 1;
+    // items of cell c are items[cell_start[c]] to items[cell_start[c + 1]]
+    std::vector<uint32_t> cell_start = {0, 0};
+    std::vector<uint32_t> items;
+    std::vector<uint32_t> cursor;
+};
+
+#endif // HIDO_SERVER_SPATIALGRID_HPP
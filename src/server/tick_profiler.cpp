@@ -0,0 +1,167 @@
+#include "tick_profiler.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iterator>
+
+namespace {
+
+void log_histogram(const char *name, const LatencyHistogram &h) {
+    spdlog::info("{:>16} {:>8} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f}",
+                 name,
+                 h.count(),
+                 h.mean() / 1000.0,
+                 h.percentile(0.5) / 1000.0,
+                 h.percentile(0.9) / 1000.0,
+                 h.percentile(0.99) / 1000.0,
+                 h.max() / 1000.0);
+}
+
+} // namespace
+
+const char *tick_phase_name(TickPhase phase) {
+    constexpr const char *NAMES[] = {
+        "wait",
+        "process_events",
+        "update",
+        "send_game_state",
+        "flush",
+    };
+    static_assert(std::size(NAMES) == (size_t)TickPhase::COUNT);
+    return NAMES[(size_t)phase];
+}
+
+size_t LatencyHistogram::bucket(uint64_t ns) {
+    ns = std::min(ns, (uint64_t{1} << VALUE_BITS) - 1);
+    if (ns < SUB_BUCKETS) return ns;
+    // the top SUB_BUCKET_BITS + 1 bits pick the bucket
+    uint32_t shift = std::bit_width(ns) - 1 - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + (ns >> shift) - SUB_BUCKETS;
+}
+
+uint64_t LatencyHistogram::bucket_max(size_t idx) {
+    if (idx < SUB_BUCKETS) return idx;
+    uint32_t shift = idx / SUB_BUCKETS - 1;
+    uint64_t sub = idx % SUB_BUCKETS + SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    counts[bucket(ns)]++;
+    total++;
+    sum += ns;
+    largest = std::max(largest, ns);
+}
+
+void LatencyHistogram::reset() {
+    counts.fill(0);
+    total = sum = largest = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (total == 0) return 0;
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(p * total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return std::min(bucket_max(i), largest);
+    }
+    return largest;
+}
+
+void TickProfiler::enable(uint64_t report_interval) {
+    on = true;
+    this->report_interval = report_interval;
+    reset(get_now_millis());
+}
+
+void TickProfiler::timer_armed(uint64_t interval_ns) {
+    if (!on) return;
+    tick_interval = interval_ns;
+    next_deadline = get_now_nanos() + interval_ns;
+}
+
+void TickProfiler::begin_tick(uint64_t expirations) {
+    if (!on) return;
+    tick_start = get_now_nanos();
+    // replays tick without a timer
+    if (next_deadline == 0) return;
+    uint64_t due = next_deadline + (expirations - 1) * tick_interval;
+    lateness.record(tick_start > due ? tick_start - due : 0);
+    next_deadline += expirations * tick_interval;
+}
+
+void TickProfiler::end_tick() {
+    if (!on) return;
+    uint64_t elapsed = get_now_nanos() - tick_start;
+    ticks.record(elapsed);
+    if (elapsed > tick_interval) overruns++;
+}
+
+void TickProfiler::poll(uint64_t now) {
+    if (!on) return;
+    bool due = report_interval != 0 && now - interval_start >= report_interval;
+    if (report_requested.exchange(false, std::memory_order_relaxed) || due) {
+        report(now);
+        reset(now);
+    }
+}
+
+void TickProfiler::report(uint64_t now) {
+    double seconds = std::max<uint64_t>(1, now - interval_start) / 1000.0;
+    spdlog::info("Profile of the last {:.1f}s, {} ticks, {} over budget.",
+                 seconds,
+                 ticks.count(),
+                 overruns);
+    spdlog::info("{:>16} {:>8} {:>9} {:>9} {:>9} {:>9} {:>9}",
+                 "phase us",
+                 "count",
+                 "mean",
+                 "p50",
+                 "p90",
+                 "p99",
+                 "max");
+    for (size_t i = 0; i < phases.size(); ++i) {
+        log_histogram(tick_phase_name((TickPhase)i), phases[i]);
+    }
+    log_histogram("tick", ticks);
+    log_histogram("tick lateness", lateness);
+
+    spdlog::info("{:>16} {:>11} {:>11} {:>11} {:>11} {:>11}",
+                 "per second",
+                 "packets in",
+                 "bytes in",
+                 "packets out",
+                 "bytes out",
+                 "dropped");
+    for (size_t i = 0; i < PACKET_TYPE_COUNT; ++i) {
+        const Traffic &t = traffic[i];
+        if (t.packets_in == 0 && t.packets_out == 0) continue;
+        // out is what the socket took
+        uint64_t packets_out =
+            t.packets_out - std::min(t.packets_out, t.packets_dropped);
+        uint64_t bytes_out =
+            t.bytes_out - std::min(t.bytes_out, t.bytes_dropped);
+        spdlog::info("{:>16} {:>11.0f} {:>11.0f} {:>11.0f} {:>11.0f} {:>11.0f}",
+                     packet_type_name((PacketType)i),
+                     t.packets_in / seconds,
+                     t.bytes_in / seconds,
+                     packets_out / seconds,
+                     bytes_out / seconds,
+                     t.packets_dropped / seconds);
+    }
+}
+
+void TickProfiler::reset(uint64_t now) {
+    interval_start = now;
+    for (LatencyHistogram &h : phases) {
+        h.reset();
+    }
+    ticks.reset();
+    lateness.reset();
+    overruns = 0;
+    traffic.fill({});
+}
@@ -0,0 +1,191 @@
+#ifndef HIDO_SERVER_TICKPROFILER_HPP
+#define HIDO_SERVER_TICKPROFILER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "network.hpp"
+#include "trace.hpp"
+
+/**
+ * Log-linear histogram of durations in nanoseconds. Each power of two is
+ * split into SUB_BUCKETS linear buckets, so a value is off by at most
+ * 1/SUB_BUCKETS of itself and memory is fixed whatever gets recorded.
+ */
+class LatencyHistogram {
+  public:
+    void record(uint64_t ns);
+    void reset();
+
+    uint64_t count() const {
+        return total;
+    }
+    uint64_t max() const {
+        return largest;
+    }
+    double mean() const {
+        return total == 0 ? 0.0 : (double)sum / total;
+    }
+
+    /**
+     * @param p quantile in [0, 1]
+     * @returns upper bound of the bucket the quantile falls in, 0 if empty
+     */
+    uint64_t percentile(double p) const;
+
+  private:
+    constexpr static uint32_t SUB_BUCKET_BITS = 4;
+    constexpr static uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    // larger values land in the last bucket, 2^40 ns is over 18 minutes
+    constexpr static uint32_t VALUE_BITS = 40;
+    constexpr static size_t BUCKETS =
+        (VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    static size_t bucket(uint64_t ns);
+    static uint64_t bucket_max(size_t idx);
+
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t total = 0, sum = 0, largest = 0;
+};
+
+// parts of a server loop iteration, timed separately
+enum class TickPhase : uint8_t {
+    WAIT, // blocked in epoll_wait
+    PROCESS_EVENTS,
+    UPDATE,
+    SEND_GAME_STATE,
+    FLUSH,
+    COUNT,
+};
+
+const char *tick_phase_name(TickPhase phase);
+
+/**
+ * Where the server's time goes, per loop phase and per tick, and the
+ * traffic of each packet type. Every call returns straight away until
+ * profiling is enabled, so it costs a branch when off.
+ */
+class TickProfiler {
+  public:
+    /**
+     * @param report_interval millis between reports, 0 only reports when
+     * one is requested
+     */
+    void enable(uint64_t report_interval);
+
+    bool enabled() const {
+        return on;
+    }
+
+    void record_phase(TickPhase phase, uint64_t ns) {
+        if (on) phases[(size_t)phase].record(ns);
+    }
+
+    /**
+     * Call when the tick timer is armed, ticks are due every interval
+     * after now
+     */
+    void timer_armed(uint64_t interval_ns);
+
+    /**
+     * @param expirations timer expirations being caught up on, the tick is
+     * late by however long ago the last of them was due
+     */
+    void begin_tick(uint64_t expirations);
+    void end_tick();
+
+    void count_in(PacketType type, size_t bytes) {
+        if (!on) return;
+        traffic[(size_t)type].packets_in++;
+        traffic[(size_t)type].bytes_in += bytes;
+    }
+    void count_out(PacketType type, size_t bytes) {
+        if (!on) return;
+        traffic[(size_t)type].packets_out++;
+        traffic[(size_t)type].bytes_out += bytes;
+    }
+    // counted out but never sent, the socket buffer was full
+    void count_dropped(PacketType type, size_t bytes) {
+        if (!on) return;
+        traffic[(size_t)type].packets_dropped++;
+        traffic[(size_t)type].bytes_dropped += bytes;
+    }
+
+    /**
+     * Asks for a report on the next poll, safe to call from a signal
+     * handler
+     */
+    void request_report() {
+        report_requested.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Logs and resets everything recorded since the last report, if one is
+     * due or was requested
+     */
+    void poll(uint64_t now);
+
+  private:
+    void report(uint64_t now);
+    void reset(uint64_t now);
+
+    struct Traffic {
+        uint64_t packets_in = 0, bytes_in = 0;
+        uint64_t packets_out = 0, bytes_out = 0;
+        uint64_t packets_dropped = 0, bytes_dropped = 0;
+    };
+
+    bool on = false;
+    uint64_t report_interval = 0;
+    // millis when the current report started
+    uint64_t interval_start = 0;
+    std::atomic<bool> report_requested = false;
+
+    std::array<LatencyHistogram, (size_t)TickPhase::COUNT> phases;
+    // every update and the snapshots sent after them
+    LatencyHistogram ticks;
+    // how long after it was due each tick started
+    LatencyHistogram lateness;
+    // ticks that took longer than the tick interval
+    uint64_t overruns = 0;
+
+    uint64_t tick_interval = TICK_INTERVAL * 1000000ull;
+    // 0 until the tick timer is armed
+    uint64_t next_deadline = 0;
+    uint64_t tick_start = 0;
+
+    std::array<Traffic, PACKET_TYPE_COUNT> traffic;
+};
+
+/**
+ * Records the time until it goes out of scope as a phase, and as a span of
+ * the trace while tracing
+ */
+class ProfileZone {
+  public:
+    ProfileZone(TickProfiler &profiler, TickPhase phase)
+        : profiler(profiler),
+          phase(phase),
+          active(profiler.enabled() || trace_enabled()) {
+        if (active) start = get_now_nanos();
+    }
+    ~ProfileZone() {
+        if (!active) return;
+        uint64_t elapsed = get_now_nanos() - start;
+        profiler.record_phase(phase, elapsed);
+        trace_complete(tick_phase_name(phase), start, elapsed);
+    }
+
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+  private:
+    TickProfiler &profiler;
+    TickPhase phase;
+    bool active;
+    uint64_t start = 0;
+};
+
+#endif // HIDO_SERVER_TICKPROFILER_HPP
@@ -0,0 +1,432 @@
+#include "snapshot.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "state/player.hpp"
+
+namespace {
+
+// which PlayerState fields follow a player's id in a delta
+enum PlayerField : uint8_t {
+    FIELD_X = 1 << 0,
+    FIELD_Y = 1 << 1,
+    FIELD_SIZE = 1 << 2,
+    FIELD_HEALTH = 1 << 3,
+    FIELD_NAME = 1 << 4,
+    FIELD_ALL = 0x1f,
+};
+
+constexpr uint32_t FIELD_BITS = 5;
+constexpr uint32_t COUNT_BITS = 16;
+constexpr uint32_t FRAGMENT_BITS = 10;
+static_assert(MAX_SNAPSHOT_FRAGMENTS <= (1u << FRAGMENT_BITS));
+// baselines are sent as an offset back from the snapshot's sequence
+constexpr uint32_t BASELINE_BITS = 5;
+static_assert(SNAPSHOT_HISTORY <= (1u << BASELINE_BITS));
+
+// ticks between a bullet's spawn and impact
+constexpr uint32_t FLIGHT_BITS = 16;
+static_assert(MAX_FLIGHT_TICKS < (1u << FLIGHT_BITS));
+
+// worst case size of one entry, a fragment is closed before it can't fit
+constexpr size_t MAX_PLAYER_BITS = ID_BITS + FIELD_BITS +
+                                   2 * POSITION_QUANTIZATION.bits() +
+                                   2 * SIZE_QUANTIZATION.bits() +
+                                   HEALTH_QUANTIZATION.bits() + 4 +
+                                   8 * MAX_NAME_LENGTH;
+constexpr size_t MAX_BULLET_BITS =
+    BULLET_ID_BITS + 1 + ID_BITS + 2 * POSITION_QUANTIZATION.bits() +
+    2 * VELOCITY_QUANTIZATION.bits() + SEQUENCE_BITS + FLIGHT_BITS;
+constexpr size_t MAX_ENTRY_BITS =
+    std::max(MAX_PLAYER_BITS, MAX_BULLET_BITS);
+
+// repeated at the start of every fragment
+constexpr size_t FRAGMENT_HEADER_BITS = PACKET_HEADER_BITS + SEQUENCE_BITS +
+                                        32 + 1 + BASELINE_BITS + ID_BITS +
+                                        SEQUENCE_BITS + FRAGMENT_BITS + 1 +
+                                        2 * COUNT_BITS;
+// a fragment is only closed once it's this full
+constexpr size_t MIN_FRAGMENT_BITS =
+    ETHERNET_MTU * 8 - FRAGMENT_HEADER_BITS - MAX_ENTRY_BITS;
+// every player and bullet of the baseline removed and as many added
+constexpr size_t MAX_DELTA_BITS =
+    MAX_CLIENTS * (ID_BITS + FIELD_BITS + MAX_PLAYER_BITS) +
+    MAX_BULLETS * (BULLET_ID_BITS + 1 + MAX_BULLET_BITS);
+// so no snapshot is ever cut short, the baseline the server stores is
+// always what the client rebuilds
+static_assert(MAX_DELTA_BITS / MIN_FRAGMENT_BITS + 2 <=
+              MAX_SNAPSHOT_FRAGMENTS);
+
+bool quantized_equal(float a, float b, const Quantization &q) {
+    return q.encode(a) == q.encode(b);
+}
+
+uint8_t changed_fields(const PlayerState &a, const PlayerState &b) {
+    // only changes the receiver can see count
+    uint8_t mask = 0;
+    if (!quantized_equal(a.rect.x, b.rect.x, POSITION_QUANTIZATION)) {
+        mask |= FIELD_X;
+    }
+    if (!quantized_equal(a.rect.y, b.rect.y, POSITION_QUANTIZATION)) {
+        mask |= FIELD_Y;
+    }
+    if (!quantized_equal(a.rect.width, b.rect.width, SIZE_QUANTIZATION) ||
+        !quantized_equal(a.rect.height, b.rect.height, SIZE_QUANTIZATION)) {
+        mask |= FIELD_SIZE;
+    }
+    if (!quantized_equal(a.health, b.health, HEALTH_QUANTIZATION)) {
+        mask |= FIELD_HEALTH;
+    }
+    if (strncmp(a.name, b.name, MAX_NAME_LENGTH) != 0) mask |= FIELD_NAME;
+    return mask;
+}
+
+void write_player(BitWriter &writer, const PlayerState &player, uint8_t mask) {
+    write_id(writer, player.id);
+    writer.write_bits(mask, FIELD_BITS);
+    if (mask & FIELD_X) {
+        writer.write_quantized(player.rect.x, POSITION_QUANTIZATION);
+    }
+    if (mask & FIELD_Y) {
+        writer.write_quantized(player.rect.y, POSITION_QUANTIZATION);
+    }
+    if (mask & FIELD_SIZE) {
+        writer.write_quantized(player.rect.width, SIZE_QUANTIZATION);
+        writer.write_quantized(player.rect.height, SIZE_QUANTIZATION);
+    }
+    if (mask & FIELD_HEALTH) {
+        writer.write_quantized(player.health, HEALTH_QUANTIZATION);
+    }
+    if (mask & FIELD_NAME) write_name(writer, player.name);
+}
+
+void read_player(BitReader &reader, PlayerState &player, uint8_t mask) {
+    if (mask & FIELD_X) {
+        player.rect.x = reader.read_quantized(POSITION_QUANTIZATION);
+    }
+    if (mask & FIELD_Y) {
+        player.rect.y = reader.read_quantized(POSITION_QUANTIZATION);
+    }
+    if (mask & FIELD_SIZE) {
+        player.rect.width = reader.read_quantized(SIZE_QUANTIZATION);
+        player.rect.height = reader.read_quantized(SIZE_QUANTIZATION);
+    }
+    if (mask & FIELD_HEALTH) {
+        player.health = reader.read_quantized(HEALTH_QUANTIZATION);
+    }
+    if (mask & FIELD_NAME) read_name(reader, player.name);
+}
+
+// the fields in mask from a player read by read_player
+void copy_fields(PlayerState &dst, const PlayerState &src, uint8_t mask) {
+    if (mask & FIELD_X) dst.rect.x = src.rect.x;
+    if (mask & FIELD_Y) dst.rect.y = src.rect.y;
+    if (mask & FIELD_SIZE) {
+        dst.rect.width = src.rect.width;
+        dst.rect.height = src.rect.height;
+    }
+    if (mask & FIELD_HEALTH) dst.health = src.health;
+    if (mask & FIELD_NAME) std::memcpy(dst.name, src.name, sizeof(dst.name));
+}
+
+// spawn, a bullet's fields never change after it
+void write_bullet(BitWriter &writer, const BulletState &bullet) {
+    writer.write_bits(bullet.id, BULLET_ID_BITS);
+    writer.write_bool(true);
+    write_id(writer, bullet.sender);
+    write_position(writer, bullet.origin);
+    writer.write_quantized(bullet.vel.x, VELOCITY_QUANTIZATION);
+    writer.write_quantized(bullet.vel.y, VELOCITY_QUANTIZATION);
+    write_sequence(writer, bullet.spawn_tick);
+    writer.write_bits(bullet.impact_tick - bullet.spawn_tick, FLIGHT_BITS);
+}
+
+void read_bullet(BitReader &reader, BulletState &bullet, uint32_t tick) {
+    bullet.sender = read_id(reader);
+    bullet.origin = read_position(reader);
+    bullet.vel.x = reader.read_quantized(VELOCITY_QUANTIZATION);
+    bullet.vel.y = reader.read_quantized(VELOCITY_QUANTIZATION);
+    bullet.spawn_tick = read_sequence(reader, tick);
+    bullet.impact_tick = bullet.spawn_tick + reader.read_bits(FLIGHT_BITS);
+}
+
+} // namespace
+
+void SnapshotHistory::store(const GameStatePacket &state) {
+    snapshots[state.sequence % SNAPSHOT_HISTORY] = state;
+}
+
+const GameStatePacket *SnapshotHistory::find(uint32_t sequence) const {
+    const GameStatePacket &state = snapshots[sequence % SNAPSHOT_HISTORY];
+    // slot may hold an older or newer snapshot
+    if (sequence == 0 || state.sequence != sequence) return nullptr;
+    return &state;
+}
+
+const PlayerState *find_player(const GameStatePacket &state, int id) {
+    auto itr = std::lower_bound(
+        state.players.begin(),
+        state.players.end(),
+        id,
+        [](const PlayerState &p, int id) { return p.id < id; });
+    if (itr == state.players.end() || itr->id != id) return nullptr;
+    return &*itr;
+}
+
+void encode_game_state(
+    const GameStatePacket &state,
+    const GameStatePacket *baseline,
+    Packet &packet,
+    const std::function<void(const Packet &, size_t)> &emit) {
+    static const GameStatePacket empty{};
+    const GameStatePacket &old = baseline ? *baseline : empty;
+
+    BitWriter writer(packet.data(), packet.size());
+    uint32_t fragment = 0, count = 0, bullet_count = 0;
+    size_t last_pos = 0, count_pos = 0, bullet_count_pos = 0;
+
+    // every fragment repeats the snapshot header so it decodes on its own
+    auto begin_fragment = [&]() {
+        writer = BitWriter(packet.data(), packet.size());
+        write_header(writer, state.header);
+        write_sequence(writer, state.sequence);
+        writer.write_bits(state.timestamp, 32);
+        writer.write_bool(baseline != nullptr);
+        if (baseline) {
+            writer.write_bits(state.sequence - baseline->sequence,
+                              BASELINE_BITS);
+        }
+        write_id(writer, state.client_id);
+        write_sequence(writer, state.input_ack);
+        writer.write_bits(fragment, FRAGMENT_BITS);
+        // last flag and counts are filled in when the fragment is closed
+        last_pos = writer.bit_position();
+        writer.write_bool(false);
+        count_pos = writer.bit_position();
+        writer.write_bits(0, COUNT_BITS);
+        bullet_count_pos = writer.bit_position();
+        writer.write_bits(0, COUNT_BITS);
+        count = 0;
+        bullet_count = 0;
+    };
+    auto end_fragment = [&](bool last) {
+        writer.overwrite_bits(last_pos, last, 1);
+        writer.overwrite_bits(count_pos, count, COUNT_BITS);
+        writer.overwrite_bits(bullet_count_pos, bullet_count, COUNT_BITS);
+        emit(packet, writer.bytes());
+        fragment++;
+    };
+    // start a new datagram if the worst case entry wouldn't fit
+    auto reserve = [&]() -> bool {
+        if (writer.bit_position() + MAX_ENTRY_BITS <= packet.size() * 8) {
+            return true;
+        }
+        if (fragment + 1 >= MAX_SNAPSHOT_FRAGMENTS) return false;
+        end_fragment(false);
+        begin_fragment();
+        return true;
+    };
+
+    // never marked last, so it's never completed, acked or used as a
+    // baseline by a client that doesn't have all of it
+    auto truncated = [&]() {
+        spdlog::warn("Snapshot {} dropped at {} fragments.",
+                     state.sequence,
+                     MAX_SNAPSHOT_FRAGMENTS);
+        end_fragment(false);
+    };
+
+    begin_fragment();
+    // both lists are sorted by id, walk them together
+    const std::vector<PlayerState> &players = state.players;
+    size_t i = 0, j = 0;
+    while (i < players.size() || j < old.players.size()) {
+        if (!reserve()) {
+            truncated();
+            return;
+        }
+        if (j == old.players.size() ||
+            (i < players.size() && players[i].id < old.players[j].id)) {
+            // new since the baseline
+            write_player(writer, players[i++], FIELD_ALL);
+            count++;
+        } else if (i == players.size() || old.players[j].id < players[i].id) {
+            // left since the baseline, an empty mask removes them
+            write_id(writer, old.players[j++].id);
+            writer.write_bits(0, FIELD_BITS);
+            count++;
+        } else {
+            // idle players cost nothing
+            uint8_t mask = changed_fields(old.players[j++], players[i]);
+            if (mask != 0) {
+                write_player(writer, players[i], mask);
+                count++;
+            }
+            i++;
+        }
+    }
+    // bullets in flight cost nothing, only spawns and despawns are sent
+    const std::vector<BulletState> &bullets = state.bullets;
+    i = 0, j = 0;
+    while (i < bullets.size() || j < old.bullets.size()) {
+        if (i < bullets.size() && j < old.bullets.size() &&
+            bullets[i].id == old.bullets[j].id) {
+            i++, j++;
+            continue;
+        }
+        if (!reserve()) {
+            truncated();
+            return;
+        }
+        if (j == old.bullets.size() ||
+            (i < bullets.size() && bullets[i].id < old.bullets[j].id)) {
+            write_bullet(writer, bullets[i++]);
+        } else {
+            writer.write_bits(old.bullets[j++].id, BULLET_ID_BITS);
+            writer.write_bool(false);
+        }
+        bullet_count++;
+    }
+    end_fragment(true);
+}
+
+bool SnapshotDecoder::decode(const Packet &packet,
+                             size_t len,
+                             uint32_t reference,
+                             GameStatePacket &out) {
+    BitReader reader(packet.data(), len);
+    PacketHeader header;
+    read_header(reader, header);
+    uint32_t sequence = read_sequence(reader, reference);
+    uint64_t timestamp = reader.read_bits(32);
+    bool has_baseline = reader.read_bool();
+    uint32_t baseline_sequence =
+        has_baseline ? sequence - reader.read_bits(BASELINE_BITS) : 0;
+    int client_id = read_id(reader);
+    // acks only move forward, so the last one is close enough to expand from
+    uint32_t input_ack = read_sequence(reader, pending.input_ack);
+    uint32_t fragment = reader.read_bits(FRAGMENT_BITS);
+    bool last = reader.read_bool();
+    uint32_t count = reader.read_bits(COUNT_BITS);
+    uint32_t bullet_count = reader.read_bits(COUNT_BITS);
+    if (!reader.ok()) return false;
+
+    // fragment of a snapshot we've moved past
+    if (pending_valid && sequence < pending.sequence) return false;
+
+    // first fragment of a new snapshot, its baseline has to be here
+    if (!pending_valid || sequence != pending.sequence) {
+        pending_valid = false;
+        if (has_baseline && history.find(baseline_sequence) == nullptr) {
+            return false;
+        }
+        pending.header = header;
+        pending.sequence = sequence;
+        pending.timestamp = timestamp;
+        pending.client_id = client_id;
+        pending.input_ack = input_ack;
+        pending_baseline = has_baseline ? baseline_sequence : 0;
+        player_deltas.clear();
+        bullet_deltas.clear();
+        received.reset();
+        last_fragment = -1;
+        pending_valid = true;
+    }
+    if (received[fragment]) return false;
+
+    // kept until every fragment is in, then merged with the baseline
+    FragmentEntries &entries = fragment_entries[fragment];
+    entries.players_begin = player_deltas.size();
+    for (uint32_t i = 0; i < count && reader.ok(); ++i) {
+        PlayerDelta &d = player_deltas.emplace_back();
+        d.state.id = read_id(reader);
+        d.mask = reader.read_bits(FIELD_BITS);
+        read_player(reader, d.state, d.mask);
+    }
+    entries.players_end = player_deltas.size();
+    entries.bullets_begin = bullet_deltas.size();
+    for (uint32_t i = 0; i < bullet_count && reader.ok(); ++i) {
+        BulletDelta &d = bullet_deltas.emplace_back();
+        d.state.id = reader.read_bits(BULLET_ID_BITS);
+        d.spawned = reader.read_bool();
+        if (d.spawned) read_bullet(reader, d.state, sequence);
+    }
+    entries.bullets_end = bullet_deltas.size();
+    // a bad fragment poisons the whole snapshot
+    if (!reader.ok()) {
+        pending_valid = false;
+        return false;
+    }
+
+    received[fragment] = true;
+    if (last) last_fragment = fragment;
+    if (last_fragment < 0 || received.count() != (size_t)last_fragment + 1) {
+        return false;
+    }
+    static const GameStatePacket empty{};
+    const GameStatePacket *baseline =
+        pending_baseline != 0 ? history.find(pending_baseline) : &empty;
+    if (baseline == nullptr) {
+        pending_valid = false;
+        return false;
+    }
+    out.header = pending.header;
+    out.sequence = pending.sequence;
+    out.timestamp = pending.timestamp;
+    out.client_id = pending.client_id;
+    out.input_ack = pending.input_ack;
+    merge(*baseline, out);
+    history.store(out);
+    return true;
+}
+
+void SnapshotDecoder::merge(const GameStatePacket &baseline,
+                            GameStatePacket &out) const {
+    // the encoder sends entries in id order across fragments, so one pass
+    // over each list rebuilds it
+    const std::vector<PlayerState> &players = baseline.players;
+    out.players.clear();
+    out.players.reserve(players.size() + player_deltas.size());
+    size_t i = 0;
+    for (int f = 0; f <= last_fragment; ++f) {
+        const FragmentEntries &entries = fragment_entries[f];
+        for (size_t d = entries.players_begin; d < entries.players_end; ++d) {
+            const PlayerDelta &delta = player_deltas[d];
+            while (i < players.size() && players[i].id < delta.state.id) {
+                out.players.push_back(players[i++]);
+            }
+            bool found = i < players.size() && players[i].id == delta.state.id;
+            // an empty mask removes them
+            if (delta.mask == 0) {
+                if (found) i++;
+            } else if (found) {
+                PlayerState &p = out.players.emplace_back(players[i++]);
+                copy_fields(p, delta.state, delta.mask);
+            } else {
+                out.players.push_back(delta.state);
+            }
+        }
+    }
+    out.players.insert(out.players.end(), players.begin() + i, players.end());
+
+    const std::vector<BulletState> &bullets = baseline.bullets;
+    out.bullets.clear();
+    out.bullets.reserve(bullets.size() + bullet_deltas.size());
+    i = 0;
+    for (int f = 0; f <= last_fragment; ++f) {
+        const FragmentEntries &entries = fragment_entries[f];
+        for (size_t d = entries.bullets_begin; d < entries.bullets_end; ++d) {
+            const BulletDelta &delta = bullet_deltas[d];
+            while (i < bullets.size() && bullets[i].id < delta.state.id) {
+                out.bullets.push_back(bullets[i++]);
+            }
+            if (i < bullets.size() && bullets[i].id == delta.state.id) i++;
+            if (delta.spawned) out.bullets.push_back(delta.state);
+        }
+    }
+    out.bullets.insert(out.bullets.end(), bullets.begin() + i, bullets.end());
+}
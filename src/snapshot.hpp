@@ -0,0 +1,114 @@
+#ifndef HIDO_SNAPSHOT_HPP
+#define HIDO_SNAPSHOT_HPP
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "network.hpp"
+
+// snapshots kept by both ends for delta baselines
+constexpr size_t SNAPSHOT_HISTORY = 32;
+// datagrams a single snapshot may be split into, enough for every player
+// and bullet to be replaced since the baseline
+constexpr size_t MAX_SNAPSHOT_FRAGMENTS = 1024;
+
+/**
+ * Ring of recent game states indexed by their snapshot sequence number
+ */
+class SnapshotHistory {
+  public:
+    void store(const GameStatePacket &state);
+
+    /**
+     * @param sequence snapshot sequence number
+     * @returns the stored snapshot or nullptr if it was never stored or has
+     * already been overwritten
+     */
+    const GameStatePacket *find(uint32_t sequence) const;
+
+  private:
+    std::array<GameStatePacket, SNAPSHOT_HISTORY> snapshots;
+};
+
+/**
+ * @param state snapshot with players sorted by id
+ * @param id player id
+ * @returns the player or nullptr if they're not in the snapshot
+ */
+const PlayerState *find_player(const GameStatePacket &state, int id);
+
+/**
+ * Encodes a game state as the fields that changed since a baseline, split
+ * into as many datagrams as needed
+ * @param state the snapshot to send, players and bullets sorted by id
+ * @param baseline snapshot acknowledged by the receiver, nullptr sends
+ * every field
+ * @param packet scratch datagram the fragments are written into
+ * @param emit called with each finished fragment and its size in bytes
+ */
+void encode_game_state(const GameStatePacket &state,
+                       const GameStatePacket *baseline,
+                       Packet &packet,
+                       const std::function<void(const Packet &, size_t)> &emit);
+
+/**
+ * Reassembles delta encoded snapshot fragments into full game states
+ */
+class SnapshotDecoder {
+  public:
+    /**
+     * @param packet received datagram
+     * @param len size of the received datagram
+     * @param reference newest server tick the receiver knows, the snapshot's
+     * 16 bit sequence is expanded against it
+     * @param out the reconstructed game state, only written on completion
+     * @returns true once every fragment of a snapshot has arrived
+     */
+    bool decode(const Packet &packet,
+                size_t len,
+                uint32_t reference,
+                GameStatePacket &out);
+
+  private:
+    struct PlayerDelta {
+        // id and the fields in mask, an empty mask removes the player
+        PlayerState state;
+        uint8_t mask = 0;
+    };
+    struct BulletDelta {
+        BulletState state;
+        // false removes the bullet
+        bool spawned = false;
+    };
+    // where a fragment's entries are in the delta lists
+    struct FragmentEntries {
+        size_t players_begin = 0, players_end = 0;
+        size_t bullets_begin = 0, bullets_end = 0;
+    };
+
+    /**
+     * Applies the deltas of every fragment to the baseline in one pass
+     * @param out players and bullets are replaced
+     */
+    void merge(const GameStatePacket &baseline, GameStatePacket &out) const;
+
+    // decoded snapshots to find baselines in
+    SnapshotHistory history;
+
+    // snapshot being reassembled, its players and bullets stay empty
+    GameStatePacket pending;
+    // 0 if it's sent in full
+    uint32_t pending_baseline = 0;
+    bool pending_valid = false;
+    std::bitset<MAX_SNAPSHOT_FRAGMENTS> received;
+    int last_fragment = -1;
+    // entries in the order they arrived, reused across snapshots
+    std::vector<PlayerDelta> player_deltas;
+    std::vector<BulletDelta> bullet_deltas;
+    std::array<FragmentEntries, MAX_SNAPSHOT_FRAGMENTS> fragment_entries;
+};
+
+#endif // HIDO_SNAPSHOT_HPP
@@ -0,0 +1,74 @@
+#ifndef HIDO_SPSCQUEUE_HPP
+#define HIDO_SPSCQUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Lock-free single producer, single consumer ring. Elements are written and
+ * read in place, so slots keep their allocations and a steady stream doesn't
+ * allocate. Neither side ever waits on the other.
+ */
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of 2");
+
+  public:
+    /**
+     * Producer only
+     * @returns the slot to fill before push(), nullptr if the queue is full
+     */
+    T *write_slot() {
+        size_t write = write_index.load(std::memory_order_relaxed);
+        if (write - read_index.load(std::memory_order_acquire) == N) {
+            return nullptr;
+        }
+        return &slots[write % N];
+    }
+
+    /**
+     * Producer only, publishes the slot from write_slot()
+     */
+    void push() {
+        write_index.store(write_index.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_release);
+    }
+
+    /**
+     * Consumer only
+     * @returns the oldest element, nullptr if the queue is empty
+     */
+    T *front() {
+        size_t read = read_index.load(std::memory_order_relaxed);
+        if (read == write_index.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots[read % N];
+    }
+
+    /**
+     * Consumer only, hands the front slot back to the producer
+     */
+    void pop() {
+        read_index.store(read_index.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_release);
+    }
+
+    /**
+     * Either side, exact for the producer, may be stale for anyone else
+     * @returns elements pushed and not yet popped
+     */
+    size_t size() const {
+        return write_index.load(std::memory_order_acquire) -
+               read_index.load(std::memory_order_acquire);
+    }
+
+  private:
+    std::array<T, N> slots;
+    // each side writes its own index, kept apart so they don't share a line
+    alignas(64) std::atomic<size_t> write_index = 0;
+    alignas(64) std::atomic<size_t> read_index = 0;
+};
+
+#endif // HIDO_SPSCQUEUE_HPP
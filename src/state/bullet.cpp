@@ -2,41 +2,100 @@
 
 #include <raylib.h>
 
+#include <cmath>
+#include <limits>
+
 #include "map/map.hpp"
 #include "network.hpp"
 
-bool bullet_update(BulletState &b, float dt, GameMap &map) {
-    b.timestamp = get_now_millis();
-    b.pos.x += b.vel.x * dt;
-    b.pos.y += b.vel.y * dt;
-
-    std::vector<tmxparser::Tile *> collided_tiles;
-    std::vector<unsigned int> collided_tile_indices;
-    Rectangle rect{b.pos.x, b.pos.y, BULLET_SIZE, BULLET_SIZE};
-
-    map.get_intersect_rects(
-        rect,
-        collided_tiles,
-        collided_tile_indices,
-        [&](tmxparser::Tile *tile, unsigned int tile_idx) -> bool {
-            (void)tile_idx;
-            std::string out;
-            return map.contains_property(*tile, "blocked", out);
-        });
-    Rectangle test_rect;
-
-    for (size_t i = 0; i < collided_tiles.size(); ++i) {
-        map.set_tile_rect(test_rect, collided_tile_indices[i]);
-        if (CheckCollisionRecs(test_rect, rect)) {
-            std::string out;
-            bool blocked =
-                map.contains_property(*collided_tiles[i], "blocked", out);
-            if (blocked) {
-                return true;
+namespace {
+
+// tiles overlapped along one axis at some position, the side the bullet is
+// moving toward includes a tile it only touches since it's about to enter it
+void axis_range(float pos, float vel, float tile, int &lo, int &hi) {
+    lo = vel < 0.0f ? (int)std::ceil(pos / tile) - 1
+                    : (int)std::floor(pos / tile);
+    hi = vel > 0.0f ? (int)std::floor((pos + BULLET_SIZE) / tile)
+                    : (int)std::ceil((pos + BULLET_SIZE) / tile) - 1;
+}
+
+// seconds until the box is entirely past the map along one axis
+float axis_exit_time(float pos, float vel, float extent) {
+    if (pos + BULLET_SIZE <= 0.0f || pos >= extent) return 0.0f;
+    if (vel > 0.0f) return (extent - pos) / vel;
+    if (vel < 0.0f) return (pos + BULLET_SIZE) / -vel;
+    return std::numeric_limits<float>::infinity();
+}
+
+} // namespace
+
+Vector2 bullet_position(const BulletState &b, uint32_t tick, float frac) {
+    // ages are small, the signed difference converts exactly however long
+    // the server has been up
+    float t = ((float)(int32_t)(tick - b.spawn_tick) + frac) * TICK_DT;
+    return {b.origin.x + b.vel.x * t, b.origin.y + b.vel.y * t};
+}
+
+float bullet_impact_time(const Vector2 &origin,
+                         const Vector2 &vel,
+                         const GameMap &map) {
+    const float tile_width = map.tileWidth, tile_height = map.tileHeight;
+    if (vel.x == 0.0f && vel.y == 0.0f) return 0.0f;
+    // nothing to hit once the box is off the map
+    const float exit_time =
+        std::min(axis_exit_time(origin.x, vel.x, map.width * tile_width),
+                 axis_exit_time(origin.y, vel.y, map.height * tile_height));
+
+    // the box only gains tiles when a leading edge crosses into the next
+    // column or row, step through those crossings in time order
+    int col_lo, col_hi, row_lo, row_hi;
+    axis_range(origin.x, vel.x, tile_width, col_lo, col_hi);
+    axis_range(origin.y, vel.y, tile_height, row_lo, row_hi);
+    for (int r = row_lo; r <= row_hi; ++r) {
+        for (int c = col_lo; c <= col_hi; ++c) {
+            if (map.is_blocked(c, r)) return 0.0f;
+        }
+    }
+    int col = vel.x > 0.0f ? col_hi : col_lo;
+    int row = vel.y > 0.0f ? row_hi : row_lo;
+    const int step_x = vel.x > 0.0f ? 1 : -1, step_y = vel.y > 0.0f ? 1 : -1;
+    const float lead_x = vel.x > 0.0f ? origin.x + BULLET_SIZE : origin.x;
+    const float lead_y = vel.y > 0.0f ? origin.y + BULLET_SIZE : origin.y;
+
+    // times are taken from the origin each step so they don't drift
+    auto next_time =
+        [](int cell, int step, float lead, float vel, float tile) {
+            if (vel == 0.0f) return std::numeric_limits<float>::infinity();
+            float boundary = (step > 0 ? cell + 1 : cell) * tile;
+            return (boundary - lead) / vel;
+        };
+    float t_x = next_time(col, step_x, lead_x, vel.x, tile_width);
+    float t_y = next_time(row, step_y, lead_y, vel.y, tile_height);
+
+    while (true) {
+        float t = std::min(t_x, t_y);
+        if (t >= exit_time) return exit_time;
+
+        float x = origin.x + vel.x * t, y = origin.y + vel.y * t;
+        int lo, hi;
+        if (t_x <= t_y) {
+            // new column, check the rows the box spans right now
+            col += step_x;
+            axis_range(y, vel.y, tile_height, lo, hi);
+            for (int r = lo; r <= hi; ++r) {
+                if (map.is_blocked(col, r)) return t;
+            }
+            t_x = next_time(col, step_x, lead_x, vel.x, tile_width);
+        } else {
+            // new row
+            row += step_y;
+            axis_range(x, vel.x, tile_width, lo, hi);
+            for (int c = lo; c <= hi; ++c) {
+                if (map.is_blocked(c, row)) return t;
             }
+            t_y = next_time(row, step_y, lead_y, vel.y, tile_height);
         }
     }
-    return false;
 }
 
 void bullet_render(const Vector2 &pos, Texture bullet_texture, Color color) {
@@ -3,17 +3,49 @@
 
 #include <raylib.h>
 
-#include "map/map.hpp"
+#include <cstdint>
+
+class GameMap;
 
 constexpr float BULLET_SIZE = 6.0f;
+constexpr float BULLET_SPEED = 300.0f;
+// bullets despawn after this many seconds or pixels even if nothing is hit
+constexpr float BULLET_LIFETIME = 3.0f, BULLET_RANGE = 800.0f;
 
+/**
+ * Bullets fly in a straight line at a constant velocity, so where and when
+ * one was fired is enough to place it at any tick
+ */
 struct BulletState {
-    uint64_t timestamp = 0;
     int sender = 0, id = -1;
-    Vector2 pos, vel;
+    Vector2 origin = {0.0f, 0.0f}, vel = {0.0f, 0.0f};
+    uint32_t spawn_tick = 0;
+    // first tick it's inside a wall or off the map
+    uint32_t impact_tick = 0;
+    // how far behind the server the shooter saw other players, server only
+    uint32_t rewind_ticks = 0;
 };
 
-bool bullet_update(BulletState &b, float dt, GameMap &map);
+/**
+ * @param b the bullet
+ * @param tick the tick to place it at
+ * @param frac how far past tick, in [0, 1) while interpolating
+ * @returns top left of the bullet at that tick
+ */
+Vector2 bullet_position(const BulletState &b, uint32_t tick, float frac = 0.0f);
+
+/**
+ * Marches the bullet's box through the tile grid, the map is only queried
+ * for tiles the box enters
+ * @param origin top left of the bullet when fired
+ * @param vel velocity in pixels per second
+ * @param map the map
+ * @returns seconds until the bullet first overlaps a blocked tile or has
+ * left the map, 0 if it's already in a wall or doesn't move
+ */
+float bullet_impact_time(const Vector2 &origin,
+                         const Vector2 &vel,
+                         const GameMap &map);
 
 void bullet_render(const Vector2 &pos, Texture bullet_texture, Color color);
 
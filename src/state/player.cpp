@@ -2,6 +2,8 @@
 
 #include <raylib.h>
 
+#include <cmath>
+
 PlayerState::PlayerState() {
     rect = Rectangle{20.0f, 20.0f, PLAYER_WIDTH, PLAYER_HEIGHT};
 }
@@ -44,70 +46,35 @@ void player_render(const PlayerState &p,
 }
 
 void player_update(PlayerState &p, const Vector2 &vel, float dt, GameMap &map) {
-    p.rect.x += vel.x * dt;
-
-    std::vector<tmxparser::Tile *> collided_tiles;
-    std::vector<unsigned int> collided_tile_indices;
-
-    map.get_intersect_rects(
-        p.rect,
-        collided_tiles,
-        collided_tile_indices,
-        [&](tmxparser::Tile *tile, unsigned int tile_idx) -> bool {
-            (void)tile_idx;
-            std::string out;
-            return map.contains_property(*tile, "blocked", out);
-        });
-    Rectangle test_rect;
+    const float tile_width = map.tileWidth, tile_height = map.tileHeight;
 
-    for (size_t i = 0; i < collided_tiles.size(); ++i) {
-        map.set_tile_rect(test_rect, collided_tile_indices[i]);
-        if (CheckCollisionRecs(test_rect, p.rect)) {
-            std::string out;
-            bool blocked =
-                map.contains_property(*collided_tiles[i], "blocked", out);
-            if (blocked) {
-                // left
-                if (vel.x < 0.0f) {
-                    p.rect.x = test_rect.x + test_rect.width;
-                }
-                // right
-                else if (vel.x > 0.0f) {
-                    p.rect.x = test_rect.x - p.rect.width;
-                }
-            }
+    p.rect.x += vel.x * dt;
+    if (map.rect_blocked(p.rect)) {
+        // left, snap to the right edge of the tile we ran into
+        if (vel.x < 0.0f) {
+            p.rect.x = (std::floor(p.rect.x / tile_width) + 1.0f) * tile_width;
+        }
+        // right
+        else if (vel.x > 0.0f) {
+            p.rect.x = std::floor((p.rect.x + p.rect.width) / tile_width) *
+                           tile_width -
+                       p.rect.width;
         }
     }
 
     // resolve movement axes separately
     p.rect.y += vel.y * dt;
-    collided_tiles.clear();
-    collided_tile_indices.clear();
-    map.get_intersect_rects(
-        p.rect,
-        collided_tiles,
-        collided_tile_indices,
-        [&](tmxparser::Tile *tile, unsigned int tile_idx) -> bool {
-            (void)tile_idx;
-            std::string out;
-            return map.contains_property(*tile, "blocked", out);
-        });
-    for (size_t i = 0; i < collided_tiles.size(); ++i) {
-        map.set_tile_rect(test_rect, collided_tile_indices[i]);
-        if (CheckCollisionRecs(test_rect, p.rect)) {
-            std::string out;
-            bool blocked =
-                map.contains_property(*collided_tiles[i], "blocked", out);
-            if (blocked) {
-                // up
-                if (vel.y < 0.0f) {
-                    p.rect.y = test_rect.y + test_rect.height;
-                }
-                // right
-                else if (vel.y > 0.0f) {
-                    p.rect.y = test_rect.y - p.rect.height;
-                }
-            }
+    if (map.rect_blocked(p.rect)) {
+        // up
+        if (vel.y < 0.0f) {
+            p.rect.y =
+                (std::floor(p.rect.y / tile_height) + 1.0f) * tile_height;
+        }
+        // down
+        else if (vel.y > 0.0f) {
+            p.rect.y = std::floor((p.rect.y + p.rect.height) / tile_height) *
+                           tile_height -
+                       p.rect.height;
         }
     }
 }
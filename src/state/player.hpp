@@ -15,7 +15,7 @@ struct PlayerState {
     PlayerState();
     Rectangle rect;
     float health = 1.0f;
-    int8_t id = -1;
+    int id = -1;
     char name[MAX_NAME_LENGTH + 1] = "Unnamed User";
 };
 
@@ -1,37 +1,106 @@
 #ifndef HIDO_STATEBUFFER_HPP
 #define HIDO_STATEBUFFER_HPP
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <deque>
 
+/**
+ * Where render_time falls between two buffered states
+ */
 template <typename T>
+struct StateSample {
+    const T *a, *b;
+    // blend factor from a to b in [0, 1]
+    float t;
+};
+
+/**
+ * Fixed ring of the most recent states in increasing timestamp order. Once
+ * full the oldest state is overwritten, so memory stays bounded however long
+ * the reader stalls, and slots are reused so nothing allocates once every
+ * slot has grown to fit its state.
+ */
+template <typename T, size_t N>
 class StateBuffer {
+    static_assert(N >= 2, "need two states to interpolate between");
+
   public:
-    StateBuffer() = default;
     size_t size() const {
-        return buffer.size();
-    }
-
-    // force second element to be after render_time
-    // shorten such that a=buffer[0] < render_time < b=buffer[1]
-    void remove_unused(uint64_t render_time) {
-        while (buffer.size() > 2 && buffer[1].header.timestamp <= render_time) {
-            buffer.pop_front();
-        }
+        return count;
     }
 
+    /**
+     * @param idx 0 is the oldest state
+     */
     T &operator[](size_t idx) {
-        return buffer[idx];
+        return slots[(head + idx) % N];
     }
     const T &operator[](size_t idx) const {
-        return buffer[idx];
+        return slots[(head + idx) % N];
+    }
+
+    /**
+     * Makes room for a state newer than every buffered one
+     * @returns the slot to overwrite, it still holds whatever was evicted
+     */
+    T &push() {
+        if (count == N) {
+            head = (head + 1) % N;
+            return (*this)[N - 1];
+        }
+        return (*this)[count++];
     }
+
     void push_back(const T &t) {
-        buffer.push_back(t);
+        push() = t;
+    }
+
+    void clear() {
+        head = count = 0;
+    }
+
+    /**
+     * @returns index of the first state after timestamp, size() if none
+     */
+    size_t upper_bound(uint64_t timestamp) const {
+        size_t lo = 0, hi = count;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if ((*this)[mid].timestamp <= timestamp) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    /**
+     * Finds the states to interpolate between, clamping to the oldest or
+     * newest pair when render_time falls outside the buffer
+     * @returns false if there are fewer than two states
+     */
+    bool sample(uint64_t render_time, StateSample<T> &out) const {
+        if (count < 2) return false;
+        size_t idx = upper_bound(render_time);
+        idx = idx == 0 ? 1 : idx == count ? count - 1 : idx;
+        out.a = &(*this)[idx - 1];
+        out.b = &(*this)[idx];
+        uint64_t from = out.a->timestamp, to = out.b->timestamp;
+        if (render_time <= from || to <= from) {
+            out.t = 0.0f;
+        } else if (render_time >= to) {
+            out.t = 1.0f;
+        } else {
+            out.t = (render_time - from) / float(to - from);
+        }
+        return true;
     }
 
   private:
-    std::deque<T> buffer;
+    std::array<T, N> slots;
+    size_t head = 0, count = 0;
 };
 
 #endif // HIDO_STATEBUFFER_HPP
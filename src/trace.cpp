@@ -0,0 +1,181 @@
+#include "trace.hpp"
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "spsc_queue.hpp"
+
+std::atomic<bool> tracing = false;
+
+namespace {
+
+// written by its thread, drained by whoever flushes
+struct TraceRing {
+    SpscQueue<TraceEvent, TRACE_RING_SIZE> events;
+    std::atomic<uint64_t> dropped = 0;
+    const char *name = nullptr;
+    int tid = 0;
+    bool name_written = false;
+};
+
+// guards the ring list and the file, a thread only takes it to add its ring
+std::mutex trace_mutex;
+std::vector<std::unique_ptr<TraceRing>> rings;
+FILE *trace_file = nullptr;
+bool first_event = true;
+int pid = 0;
+std::atomic<bool> flush_requested = false;
+// a ring is filling up, flushed without logging
+std::atomic<bool> drain_requested = false;
+
+thread_local TraceRing *thread_ring = nullptr;
+
+TraceRing &get_ring() {
+    if (thread_ring == nullptr) {
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        rings.push_back(std::make_unique<TraceRing>());
+        thread_ring = rings.back().get();
+        thread_ring->tid = rings.size();
+    }
+    return *thread_ring;
+}
+
+// the array format, so a file cut short by a crash still opens
+void begin_event() {
+    std::fputs(first_event ? "\n" : ",\n", trace_file);
+    first_event = false;
+}
+
+void write_metadata(const char *kind, int tid, const char *name) {
+    begin_event();
+    fmt::print(trace_file,
+               "{{\"ph\": \"M\", \"name\": \"{}\", \"pid\": {}, \"tid\": {}, "
+               "\"args\": {{\"name\": \"{}\"}}}}",
+               kind,
+               pid,
+               tid,
+               name);
+}
+
+// trace_mutex must be held
+void flush_rings() {
+    for (const std::unique_ptr<TraceRing> &ring : rings) {
+        if (ring->name != nullptr && !ring->name_written) {
+            write_metadata("thread_name", ring->tid, ring->name);
+            ring->name_written = true;
+        }
+        while (const TraceEvent *e = ring->events.front()) {
+            begin_event();
+            // microseconds
+            double ts = e->start / 1000.0;
+            if (e->instant) {
+                fmt::print(trace_file,
+                           "{{\"ph\": \"i\", \"s\": \"t\", \"name\": \"{}\", "
+                           "\"pid\": {}, \"tid\": {}, \"ts\": {:.3f}, "
+                           "\"args\": {{\"value\": {}}}}}",
+                           e->name,
+                           pid,
+                           ring->tid,
+                           ts,
+                           e->value);
+            } else {
+                fmt::print(trace_file,
+                           "{{\"ph\": \"X\", \"name\": \"{}\", \"pid\": {}, "
+                           "\"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}}}",
+                           e->name,
+                           pid,
+                           ring->tid,
+                           ts,
+                           e->duration / 1000.0);
+            }
+            ring->events.pop();
+        }
+        uint64_t dropped = ring->dropped.exchange(0);
+        if (dropped > 0) {
+            spdlog::warn("Trace of thread {} was full, dropped {} events.",
+                         ring->tid,
+                         dropped);
+        }
+    }
+    std::fflush(trace_file);
+}
+
+} // namespace
+
+bool trace_start(const std::string &path, const char *process_name) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (trace_file != nullptr) return false;
+    trace_file = std::fopen(path.c_str(), "w");
+    if (trace_file == nullptr) {
+        spdlog::error("Failed to open trace file: '{}'.", path);
+        return false;
+    }
+    pid = getpid();
+    first_event = true;
+    fmt::print(trace_file, "[");
+    write_metadata("process_name", 0, process_name);
+    tracing = true;
+    spdlog::info("Tracing to '{}'.", path);
+    return true;
+}
+
+void trace_stop() {
+    tracing = false;
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (trace_file == nullptr) return;
+    flush_rings();
+    fmt::print(trace_file, "\n]\n");
+    std::fclose(trace_file);
+    trace_file = nullptr;
+}
+
+void trace_thread_name(const char *name) {
+    if (!trace_enabled()) return;
+    TraceRing &ring = get_ring();
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    ring.name = name;
+}
+
+void trace_request_flush() {
+    flush_requested.store(true, std::memory_order_relaxed);
+}
+
+void trace_poll() {
+    bool requested = flush_requested.exchange(false, std::memory_order_relaxed);
+    bool draining = drain_requested.exchange(false, std::memory_order_relaxed);
+    if (!requested && !draining) return;
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (trace_file == nullptr) return;
+    flush_rings();
+    if (requested) spdlog::info("Flushed trace.");
+}
+
+void trace_record(const TraceEvent &event) {
+    TraceRing &ring = get_ring();
+    TraceEvent *slot = ring.events.write_slot();
+    if (slot == nullptr) {
+        // nobody polled in time, write everything out here rather than
+        // lose what follows
+        {
+            std::lock_guard<std::mutex> lock(trace_mutex);
+            if (trace_file != nullptr) flush_rings();
+        }
+        slot = ring.events.write_slot();
+        if (slot == nullptr) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    *slot = event;
+    ring.events.push();
+    // have the next poll drain it long before it's full
+    if (ring.events.size() == TRACE_RING_SIZE / 2) {
+        drain_requested.store(true, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef HIDO_TRACE_HPP
+#define HIDO_TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "network.hpp"
+
+// events each thread can hold between flushes, the rest are dropped
+constexpr size_t TRACE_RING_SIZE = 1 << 17;
+
+/**
+ * One timed span, or a point in time if it's an instant
+ */
+struct TraceEvent {
+    // static strings only, they're written out long after
+    const char *name = nullptr;
+    uint64_t start = 0; // steady clock nanos
+    uint64_t duration = 0;
+    uint32_t value = 0; // written as an argument of instants
+    bool instant = false;
+};
+
+// checked before touching the clock so tracing costs a load when off
+extern std::atomic<bool> tracing;
+
+inline bool trace_enabled() {
+    return tracing.load(std::memory_order_relaxed);
+}
+
+/**
+ * Starts recording to a Chrome trace event file, which chrome://tracing
+ * and ui.perfetto.dev open. Each thread records into its own lock-free
+ * ring, written out on a flush or by the next poll once it's half full, and
+ * by the thread itself if it fills before then. Timestamps are the steady
+ * clock, so traces of processes on the same machine line up.
+ * @param process_name what the process is called in the trace
+ * @returns false if the file couldn't be opened
+ */
+bool trace_start(const std::string &path, const char *process_name);
+
+/**
+ * Flushes every thread's events, finishes the file and stops recording
+ */
+void trace_stop();
+
+/**
+ * Names the calling thread in the trace
+ * @param name a static string
+ */
+void trace_thread_name(const char *name);
+
+/**
+ * Asks for a flush on the next poll, safe to call from a signal handler
+ */
+void trace_request_flush();
+
+/**
+ * Appends every thread's events to the file if a flush was requested or a
+ * ring is filling up, call it regularly from one thread
+ */
+void trace_poll();
+
+void trace_record(const TraceEvent &event);
+
+inline void trace_complete(const char *name,
+                           uint64_t start,
+                           uint64_t duration) {
+    if (trace_enabled()) trace_record({name, start, duration, 0, false});
+}
+
+/**
+ * @param value shown with the event, like the size of a packet
+ */
+inline void trace_instant(const char *name, uint32_t value) {
+    if (trace_enabled()) trace_record({name, get_now_nanos(), 0, value, true});
+}
+
+/**
+ * Records the time until it goes out of scope as a span
+ */
+class TraceZone {
+  public:
+    explicit TraceZone(const char *name)
+        : name(trace_enabled() ? name : nullptr) {
+        if (this->name) start = get_now_nanos();
+    }
+    ~TraceZone() {
+        if (name) trace_complete(name, start, get_now_nanos() - start);
+    }
+
+    TraceZone(const TraceZone &) = delete;
+    TraceZone &operator=(const TraceZone &) = delete;
+
+  private:
+    const char *name;
+    uint64_t start = 0;
+};
+
+#endif // HIDO_TRACE_HPP
@@ -0,0 +1,50 @@
+#include "client/clock_sync.hpp"
+
+#include "test.hpp"
+
+namespace {
+
+constexpr uint64_t DAY = 24 * 60 * 60 * 1000ull;
+
+/**
+ * Syncs to a server up for server_uptime when we've been up for now, then
+ * receives snapshots sent 50ms before they arrive
+ */
+void check_uptimes(uint64_t server_uptime, uint64_t now) {
+    ClockSync clock;
+    const uint64_t one_way = 10;
+    for (size_t i = 0; i < SYNC_PINGS; ++i) {
+        PingPacket pong;
+        pong.client_time = now - 2 * one_way;
+        pong.server_time = server_uptime - one_way;
+        clock.on_pong(pong, now);
+        now += 16;
+        server_uptime += 16;
+    }
+    CHECK(clock.synced());
+    // the server clock's low bits as estimated
+    CHECK((uint32_t)clock.server_now(now) == (uint32_t)server_uptime);
+
+    for (uint32_t sequence = 1; sequence <= 60; ++sequence) {
+        uint32_t sent = server_uptime - 50;
+        uint64_t timestamp = clock.expand_server_millis(sent, now);
+        CHECK(clock.server_now(now) - timestamp == 50);
+        clock.on_snapshot(sequence, timestamp, now);
+        // rendered behind the newest snapshot, never past it
+        CHECK(clock.render_time(now) < timestamp);
+        now += TICK_INTERVAL;
+        server_uptime += TICK_INTERVAL;
+    }
+    CHECK(clock.get_delay() < MAX_INTERPOLATION_DELAY);
+}
+
+} // namespace
+
+void test_clock_sync() {
+    check_uptimes(DAY, DAY);
+    // a large negative offset and a small now
+    check_uptimes(40 * DAY, DAY);
+    check_uptimes(40 * DAY, 1000);
+    // and the other way round
+    check_uptimes(1000, 40 * DAY);
+}
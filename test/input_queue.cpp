@@ -0,0 +1,89 @@
+#include "server/input_queue.hpp"
+
+#include "test.hpp"
+
+namespace {
+
+InputPacket input(uint32_t sequence) {
+    InputPacket p;
+    p.sequence = sequence;
+    return p;
+}
+
+// one server tick, returns the inputs applied
+size_t tick(InputQueue &queue) {
+    size_t applied = 0;
+    while (queue.pop() != nullptr) applied++;
+    queue.end_tick();
+    return applied;
+}
+
+// nothing consumed yet must not ack every input the client has
+void test_no_inputs() {
+    InputQueue queue;
+    CHECK(queue.last_consumed() == 0);
+    tick(queue);
+    CHECK(queue.last_consumed() == 0);
+}
+
+void test_in_order() {
+    InputQueue queue;
+    for (uint32_t s = 1; s <= 10; ++s) {
+        CHECK(queue.push(input(s)));
+        CHECK(!queue.push(input(s)));
+        CHECK(tick(queue) == 1);
+        CHECK(queue.last_consumed() == s);
+    }
+    // already consumed
+    CHECK(!queue.push(input(5)));
+}
+
+// a lost input is waited for, then skipped
+void test_single_loss() {
+    InputQueue queue;
+    queue.push(input(1));
+    tick(queue);
+    queue.push(input(3));
+    size_t applied = 0;
+    for (uint32_t i = 0; i <= INPUT_JITTER_TICKS; ++i) {
+        applied += tick(queue);
+    }
+    CHECK(applied == 1);
+    CHECK(queue.last_consumed() == 3);
+}
+
+// an outage longer than the ring, the client carries on from further ahead
+// than the queue buffers
+void test_burst_outage() {
+    InputQueue queue;
+    uint32_t sequence = 0;
+    for (int i = 0; i < 10; ++i) {
+        queue.push(input(++sequence));
+        tick(queue);
+    }
+    CHECK(queue.last_consumed() == 10);
+    // 1.5s of inputs never arrive
+    sequence += 90;
+    // then batches of the newest few, a tick each
+    for (int i = 0; i < 600; ++i) {
+        ++sequence;
+        for (uint32_t s = sequence - 3; s <= sequence; ++s) {
+            queue.push(input(s));
+        }
+        tick(queue);
+    }
+    CHECK(queue.last_consumed() + INPUT_JITTER_TICKS >= sequence);
+    // and it keeps up from there
+    queue.push(input(++sequence));
+    CHECK(tick(queue) >= 1);
+    CHECK(queue.last_consumed() == sequence);
+}
+
+} // namespace
+
+void test_input_queue() {
+    test_no_inputs();
+    test_in_order();
+    test_single_loss();
+    test_burst_outage();
+}
@@ -0,0 +1,50 @@
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test.hpp"
+
+namespace {
+
+struct Suite {
+    const char *name;
+    void (*run)();
+};
+
+constexpr Suite SUITES[] = {
+    {"input_queue", test_input_queue},
+    {"snapshot", test_snapshot},
+    {"clock_sync", test_clock_sync},
+};
+
+size_t failures = 0;
+
+} // namespace
+
+void check_failed(const char *expr, const char *file, int line) {
+    fmt::print(stderr, "{}:{}: check failed: {}\n", file, line, expr);
+    failures++;
+}
+
+size_t failure_count() {
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> selected(argv + 1, argv + argc);
+    for (const Suite &suite : SUITES) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(),
+                                           suite.name) == selected.end()) {
+            continue;
+        }
+        size_t before = failures;
+        suite.run();
+        fmt::print("{:<16} {}\n",
+                   suite.name,
+                   failures == before ? "ok" : "FAILED");
+    }
+    return failure_count() == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include "snapshot.hpp"
+
+#include <cstdio>
+#include <vector>
+
+#include "test.hpp"
+
+namespace {
+
+struct Fragment {
+    Packet packet;
+    size_t len;
+};
+
+std::vector<Fragment> encode(const GameStatePacket &state,
+                             const GameStatePacket *baseline) {
+    std::vector<Fragment> fragments;
+    Packet packet;
+    encode_game_state(
+        state, baseline, packet, [&](const Packet &fragment, size_t len) {
+            fragments.push_back({fragment, len});
+        });
+    return fragments;
+}
+
+// true once the last fragment completes the snapshot
+bool decode(SnapshotDecoder &decoder,
+            const std::vector<Fragment> &fragments,
+            uint32_t reference,
+            GameStatePacket &out) {
+    bool complete = false;
+    for (const Fragment &f : fragments) {
+        complete = decoder.decode(f.packet, f.len, reference, out);
+    }
+    return complete;
+}
+
+/**
+ * As many players and bullets as there can be, each generation has other
+ * ids so the next one replaces all of them
+ */
+GameStatePacket full_state(uint32_t sequence, int generation) {
+    GameStatePacket state;
+    state.header.type = PacketType::GAME_STATE;
+    state.sequence = sequence;
+    for (size_t i = 0; i < MAX_CLIENTS; ++i) {
+        PlayerState p;
+        p.id = generation * MAX_CLIENTS + i;
+        p.rect.x = i % 64 * 32.0f;
+        p.rect.y = i / 64 * 32.0f;
+        std::snprintf(p.name, sizeof(p.name), "player %zu", i);
+        state.players.push_back(p);
+    }
+    for (size_t i = 0; i < MAX_BULLETS; ++i) {
+        BulletState b;
+        b.id = generation * MAX_BULLETS + i;
+        b.sender = generation * MAX_CLIENTS + i % MAX_CLIENTS;
+        b.origin = {i % 256 * 8.0f, i / 256 * 8.0f};
+        b.vel = {BULLET_SPEED, -BULLET_SPEED};
+        b.spawn_tick = sequence;
+        b.impact_tick = sequence + 100;
+        state.bullets.push_back(b);
+    }
+    return state;
+}
+
+bool same_entities(const GameStatePacket &a, const GameStatePacket &b) {
+    if (a.players.size() != b.players.size() ||
+        a.bullets.size() != b.bullets.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.players.size(); ++i) {
+        if (a.players[i].id != b.players[i].id ||
+            a.players[i].rect.x != b.players[i].rect.x ||
+            a.players[i].rect.y != b.players[i].rect.y) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.bullets.size(); ++i) {
+        if (a.bullets[i].id != b.bullets[i].id ||
+            a.bullets[i].origin.x != b.bullets[i].origin.x ||
+            a.bullets[i].spawn_tick != b.bullets[i].spawn_tick ||
+            a.bullets[i].impact_tick != b.bullets[i].impact_tick) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the largest snapshots there can be arrive whole, so the baseline the
+// server stores is the one the client rebuilds
+void test_worst_case_fits() {
+    SnapshotDecoder decoder;
+    GameStatePacket baseline = full_state(100, 0);
+    GameStatePacket out;
+    std::vector<Fragment> fragments = encode(baseline, nullptr);
+    CHECK(fragments.size() <= MAX_SNAPSHOT_FRAGMENTS);
+    CHECK(decode(decoder, fragments, baseline.sequence, out));
+    CHECK(same_entities(out, baseline));
+
+    // every entity replaced, decoded against the stored baseline
+    GameStatePacket next = full_state(101, 1);
+    fragments = encode(next, &baseline);
+    CHECK(fragments.size() <= MAX_SNAPSHOT_FRAGMENTS);
+    CHECK(decode(decoder, fragments, next.sequence, out));
+    CHECK(same_entities(out, next));
+}
+
+} // namespace
+
+void test_snapshot() {
+    test_worst_case_fits();
+}
@@ -0,0 +1,38 @@
+#ifndef HIDO_TEST_TEST_HPP
+#define HIDO_TEST_TEST_HPP
+
+#include <cstddef>
+
+/**
+ * Logs a failed check and counts it, the run fails if any did
+ */
+void check_failed(const char *expr, const char *file, int line);
+
+/**
+ * @returns checks failed so far
+ */
+size_t failure_count();
+
+#define CHECK(expr)                                                           \
+    do {                                                                      \
+        if (!(expr)) check_failed(#expr, __FILE__, __LINE__);                 \
+    } while (false)
+
+/**
+ * Inputs going through the server's per client queue, in order, with loss
+ * and outages
+ */
+void test_input_queue();
+
+/**
+ * The client's estimate of the server clock and the render time it gives,
+ * whichever side has been up longer
+ */
+void test_clock_sync();
+
+/**
+ * Snapshots encoded and decoded against their baselines
+ */
+void test_snapshot();
+
+#endif // HIDO_TEST_TEST_HPP